@@ -13,6 +13,7 @@ struct service_t
 {
   std::string name = "";
   std::string service = "";
+  bool run_to_completion = false;
 };
 
 struct websocket_client_service_t : public service_t
@@ -27,6 +28,9 @@ struct http_server_service_t : public service_t
 {
   std::string host = "";
   unsigned short port = 0;
+  unsigned timeout_ms = 0;
+  unsigned acceptors = 1;
+  bool reuse_port = false;
 };
 
 struct pipeline_t
@@ -35,6 +39,12 @@ struct pipeline_t
   std::string pipeline = "";
   std::string source = "";
   std::vector<ServicePacket::EStatus> event = { ServicePacket::EStatus::DATA_TRANSMISSION };
+  // Run the stage for up to this many packets at once on the service threads, at most as many as there are
+  unsigned parallelism = 1;
+  // Emit the results of a parallel stage in the order of their input, rather than as soon as they are done
+  bool ordered = true;
+  // JSON pointer to the key of a packet, packets with the same key run one at a time in the order they came in
+  std::string partition = "";
 };
 
 struct inja_pipeline_t : public pipeline_t
@@ -58,9 +68,48 @@ struct buffer_pipeline_t : public pipeline_t
   std::vector<ServicePacket::EStatus> trigger_event = { ServicePacket::EStatus::DATA_TRANSMISSION };
 };
 
+struct threads_t
+{
+  // 0 uses one thread per core
+  unsigned session = 1;
+  unsigned service = 1;
+  // Give every session thread an io_context of its own and spread accepted connections over them
+  bool sharded = false;
+};
+
+struct resolver_t
+{
+  unsigned ttl = 60;
+  unsigned negative_ttl = 5;
+};
+
 struct http_client_pipeline_t : public pipeline_t
 {
   bool ssl = false;
+  std::size_t max_in_flight = 64;
+  bool coalesce = true;
+  std::size_t cache_bytes = 0;
+  std::size_t retries = 0;
+  unsigned retry_backoff_ms = 100;
+  double hedge_percentile = 0;
+  unsigned hedge_delay_ms = 100;
+  std::size_t max_body_bytes = 8 * 1024 * 1024;
+  std::string streaming = "none";
+};
+
+struct http_scatter_gather_pipeline_t : public http_client_pipeline_t
+{
+  unsigned timeout_ms = 5000;
+};
+
+// A chain of pure stages fused into one by optimize_configuration, never parsed from a file. Each stage is applied
+// to the output of the previous one, at most one of them is a jq stage. Source and event are those of the first
+// stage, the name is that of the last one.
+struct fused_pipeline_t : public pipeline_t
+{
+  using stage_t = std::variant<jq_pipeline_t, inja_pipeline_t, emit_pipeline_t>;
+
+  std::vector<stage_t> stages = {};
 };
 }
 
@@ -71,11 +120,15 @@ struct configuration_t
                                   config::jq_pipeline_t,
                                   config::buffer_pipeline_t,
                                   config::emit_pipeline_t,
-                                  config::http_client_pipeline_t>;
+                                  config::http_client_pipeline_t,
+                                  config::http_scatter_gather_pipeline_t,
+                                  config::fused_pipeline_t>;
   using endpoint_t = std::string;
 
   std::vector<service_t> services = {};
   std::vector<pipeline_t> pipelines = {};
   std::vector<endpoint_t> endpoints = {};
+  config::resolver_t resolver = {};
+  config::threads_t threads = {};
 };
 }
@@ -0,0 +1,25 @@
+#pragma once
+#include <trawler/cli/configuration.hpp>
+#include <trawler/logging/logger.hpp>
+
+namespace trawler {
+
+/*******************************************************************************
+ * optimize_configuration
+ *
+ * Rewrites the pipelines of a configuration into an equivalent dataflow graph
+ * that is cheaper to run:
+ *
+ *   - jq, inja and emit stages identical to an earlier one (same source, same
+ *     events, parallelism, partition and script, template or data) are merged
+ *     into it
+ *   - pipelines no endpoint depends on are removed
+ *   - chains of serial jq, inja and emit stages where every stage feeds
+ *     nothing but the next one are fused into a single fused_pipeline_t
+ *
+ * Pipelines must come after the pipelines they read from, just like for
+ * spawn_pipelines.
+ ******************************************************************************/
+configuration_t
+optimize_configuration(configuration_t configuration, const Logger& logger = { "optimizer" });
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <trawler/logging/logger.hpp>
+
+namespace trawler {
+
+/*******************************************************************************
+ * supervise_workers
+ *
+ * Forks nof_workers processes, each calling worker with its index and exiting
+ * with the result, and restarts every worker that crashes or exits with an
+ * error. A worker crashing sooner than restart_delay after it was started is
+ * restarted only once that much time has passed, and is given up on after
+ * max_fast_failures such crashes in a row (0 never gives up). A worker throwing
+ * exits with an error. SIGINT and SIGTERM are passed on to the workers as
+ * SIGTERM, which are then no longer restarted.
+ *
+ * Returns in the supervisor once all workers have exited, with 0 if they all
+ * exited successfully the last time. A worker killed by the SIGTERM passed on
+ * to it counts as successful. Must be called before any threads are started.
+ ******************************************************************************/
+int
+supervise_workers(std::size_t nof_workers,
+                  const std::function<int(std::size_t)>& worker,
+                  const Logger& logger,
+                  std::chrono::milliseconds restart_delay = std::chrono::seconds{ 1 },
+                  std::size_t max_fast_failures = 5);
+}
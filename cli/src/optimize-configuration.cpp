@@ -0,0 +1,226 @@
+#include "overloaded.hpp"
+#include <algorithm>
+#include <optional>
+#include <set>
+#include <trawler/cli/optimize-configuration.hpp>
+
+namespace trawler {
+
+namespace {
+
+using pipelines_t = std::vector<configuration_t::pipeline_t>;
+using stages_t = std::vector<config::fused_pipeline_t::stage_t>;
+
+const config::pipeline_t&
+get_common(const configuration_t::pipeline_t& pipe)
+{
+  return std::visit([](const auto& p) -> const config::pipeline_t& { return p; }, pipe);
+}
+
+std::vector<std::string>
+get_sources(const configuration_t::pipeline_t& pipe)
+{
+  if (const auto* buffer = std::get_if<config::buffer_pipeline_t>(&pipe)) {
+    return { buffer->source, buffer->trigger_source };
+  }
+  return { get_common(pipe).source };
+}
+
+void
+rename_source(configuration_t::pipeline_t& pipe, const std::string& from, const std::string& to)
+{
+  std::visit(
+    [&](auto& p) {
+      if (p.source == from) {
+        p.source = to;
+      }
+    },
+    pipe);
+  if (auto* buffer = std::get_if<config::buffer_pipeline_t>(&pipe)) {
+    if (buffer->trigger_source == from) {
+      buffer->trigger_source = to;
+    }
+  }
+}
+
+bool
+has_same_input(const config::pipeline_t& a, const config::pipeline_t& b)
+{
+  return a.source == b.source && a.event == b.event && a.parallelism == b.parallelism && a.ordered == b.ordered &&
+         a.partition == b.partition;
+}
+
+// Only pure stages are merged, two http-client stages are expected to make two requests
+bool
+is_identical(const configuration_t::pipeline_t& a, const configuration_t::pipeline_t& b)
+{
+  const auto identical = overloaded{
+    [](const config::jq_pipeline_t& x, const config::jq_pipeline_t& y) {
+      return has_same_input(x, y) && x.script == y.script;
+    },
+    [](const config::inja_pipeline_t& x, const config::inja_pipeline_t& y) {
+      return has_same_input(x, y) && x.tmplate == y.tmplate;
+    },
+    [](const config::emit_pipeline_t& x, const config::emit_pipeline_t& y) {
+      return has_same_input(x, y) && x.data == y.data;
+    },
+    [](const auto&, const auto&) { return false; },
+  };
+  return std::visit(identical, a, b);
+}
+
+// The pure stages a pipeline consists of, if it consists of nothing else
+std::optional<stages_t>
+get_pure_stages(const configuration_t::pipeline_t& pipe)
+{
+  const auto visitor = overloaded{
+    [](const config::jq_pipeline_t& p) -> std::optional<stages_t> { return stages_t{ p }; },
+    [](const config::inja_pipeline_t& p) -> std::optional<stages_t> { return stages_t{ p }; },
+    [](const config::emit_pipeline_t& p) -> std::optional<stages_t> { return stages_t{ p }; },
+    [](const config::fused_pipeline_t& p) -> std::optional<stages_t> { return p.stages; },
+    [](const auto&) -> std::optional<stages_t> { return std::nullopt; },
+  };
+  return std::visit(visitor, pipe);
+}
+
+std::size_t
+count_jq_stages(const stages_t& stages)
+{
+  const auto is_jq = [](const auto& stage) { return std::holds_alternative<config::jq_pipeline_t>(stage); };
+  return static_cast<std::size_t>(std::count_if(cbegin(stages), cend(stages), is_jq));
+}
+
+std::size_t
+count_consumers(const configuration_t& configuration, const std::string& name)
+{
+  const auto& endpoints = configuration.endpoints;
+  auto count = static_cast<std::size_t>(std::count(cbegin(endpoints), cend(endpoints), name));
+  for (const auto& pipe : configuration.pipelines) {
+    const auto sources = get_sources(pipe);
+    count += static_cast<std::size_t>(std::count(cbegin(sources), cend(sources), name));
+  }
+  return count;
+}
+
+void
+merge_identical_stages(configuration_t& configuration, const Logger& logger)
+{
+  auto& pipelines = configuration.pipelines;
+  for (std::size_t i = 0; i < pipelines.size( ); ++i) {
+    for (std::size_t j = i + 1; j < pipelines.size( );) {
+      if (!is_identical(pipelines[i], pipelines[j])) {
+        ++j;
+        continue;
+      }
+
+      const auto original = get_common(pipelines[i]).name;
+      const auto duplicate = get_common(pipelines[j]).name;
+      logger.info("Merging pipeline [" + duplicate + "] into the identical [" + original + "]");
+      pipelines.erase(begin(pipelines) + static_cast<std::ptrdiff_t>(j));
+
+      for (auto& pipe : pipelines) {
+        rename_source(pipe, duplicate, original);
+      }
+      std::replace(begin(configuration.endpoints), end(configuration.endpoints), duplicate, original);
+    }
+  }
+
+  // Merged endpoints would otherwise answer the same packets twice
+  auto seen = std::set<std::string>{ };
+  const auto is_seen = [&seen](const std::string& endpoint) { return !seen.insert(endpoint).second; };
+  auto& endpoints = configuration.endpoints;
+  endpoints.erase(std::remove_if(begin(endpoints), end(endpoints), is_seen), end(endpoints));
+}
+
+void
+remove_unreachable_stages(configuration_t& configuration, const Logger& logger)
+{
+  auto& pipelines = configuration.pipelines;
+
+  // Pipelines only read from earlier ones, so a single pass from the back finds everything the endpoints depend on
+  auto reachable = std::set<std::string>{ cbegin(configuration.endpoints), cend(configuration.endpoints) };
+  for (auto pipe = crbegin(pipelines); pipe != crend(pipelines); ++pipe) {
+    if (reachable.count(get_common(*pipe).name)) {
+      const auto sources = get_sources(*pipe);
+      reachable.insert(cbegin(sources), cend(sources));
+    }
+  }
+
+  const auto is_unreachable = [&](const configuration_t::pipeline_t& pipe) {
+    const auto& name = get_common(pipe).name;
+    if (reachable.count(name)) {
+      return false;
+    }
+    logger.info("Removing pipeline [" + name + "], no endpoint depends on it");
+    return true;
+  };
+  pipelines.erase(std::remove_if(begin(pipelines), end(pipelines), is_unreachable), end(pipelines));
+}
+
+void
+fuse_pure_chains(configuration_t& configuration, const Logger& logger)
+{
+  auto& pipelines = configuration.pipelines;
+  for (std::size_t i = 0; i < pipelines.size( ); ++i) {
+    const auto consumer_stages = get_pure_stages(pipelines[i]);
+    if (!consumer_stages || std::holds_alternative<config::fused_pipeline_t>(pipelines[i])) {
+      continue;
+    }
+    const auto& consumer = get_common(pipelines[i]);
+    // A parallel stage runs on a node of its own
+    if (consumer.parallelism > 1) {
+      continue;
+    }
+
+    const auto is_producer = [&](const auto& pipe) { return get_common(pipe).name == consumer.source; };
+    const auto last = begin(pipelines) + static_cast<std::ptrdiff_t>(i);
+    const auto producer = std::find_if(begin(pipelines), last, is_producer);
+    if (producer == last) {
+      continue;
+    }
+
+    auto stages = get_pure_stages(*producer);
+    if (!stages || get_common(*producer).parallelism > 1 || count_consumers(configuration, consumer.source) != 1) {
+      continue;
+    }
+
+    // Pure stages keep the status of their input, so the events of the producer must all pass the consumer
+    const auto& producer_events = get_common(*producer).event;
+    const auto is_accepted = [&](auto event) {
+      return std::find(cbegin(consumer.event), cend(consumer.event), event) != cend(consumer.event);
+    };
+    if (!std::all_of(cbegin(producer_events), cend(producer_events), is_accepted)) {
+      continue;
+    }
+
+    // A jq stage may produce several packets, only one of them per chain keeps it a single flat_map
+    if (count_jq_stages(*stages) + count_jq_stages(*consumer_stages) > 1) {
+      continue;
+    }
+
+    logger.info("Fusing pipeline [" + get_common(*producer).name + "] into [" + consumer.name + "]");
+    auto fused = config::fused_pipeline_t{ };
+    fused.name = consumer.name;
+    fused.pipeline = "fused";
+    fused.source = get_common(*producer).source;
+    fused.event = producer_events;
+    fused.stages = std::move(*stages);
+    fused.stages.insert(end(fused.stages), cbegin(*consumer_stages), cend(*consumer_stages));
+
+    pipelines[i] = std::move(fused);
+    pipelines.erase(producer);
+    --i;
+  }
+}
+}
+
+configuration_t
+optimize_configuration(configuration_t configuration, const Logger& logger)
+{
+  logger.debug("Optimizing pipelines");
+  merge_identical_stages(configuration, logger);
+  remove_unreachable_stages(configuration, logger);
+  fuse_pure_chains(configuration, logger);
+  return configuration;
+}
+}
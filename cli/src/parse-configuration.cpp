@@ -1,4 +1,5 @@
 #include <iostream>
+#include <nlohmann/json.hpp>
 #include <trawler/cli/parse-configuration.hpp>
 #include <yaml-cpp/yaml.h>
 
@@ -18,6 +19,9 @@ struct convert<trawler::config::websocket_client_service_t>
     svc.port = node["port"].as<unsigned short>( );
     svc.target = node["target"].as<std::string>( );
     svc.ssl = node["ssl"].as<bool>( );
+    if (node["run_to_completion"]) {
+      svc.run_to_completion = node["run_to_completion"].as<bool>( );
+    }
     return true;
   }
 };
@@ -34,6 +38,18 @@ struct convert<trawler::config::http_server_service_t>
     svc.service = node["service"].as<std::string>( );
     svc.host = node["host"].as<std::string>( );
     svc.port = node["port"].as<unsigned short>( );
+    if (node["timeout_ms"]) {
+      svc.timeout_ms = node["timeout_ms"].as<unsigned>( );
+    }
+    if (node["acceptors"]) {
+      svc.acceptors = node["acceptors"].as<unsigned>( );
+    }
+    if (node["reuse_port"]) {
+      svc.reuse_port = node["reuse_port"].as<bool>( );
+    }
+    if (node["run_to_completion"]) {
+      svc.run_to_completion = node["run_to_completion"].as<bool>( );
+    }
     return true;
   }
 };
@@ -92,6 +108,25 @@ struct convert<trawler::config::pipeline_t>
     if (auto events = get_events(node, "event")) {
       pipe.event = std::move(events.value( ));
     }
+    if (node["parallelism"]) {
+      pipe.parallelism = node["parallelism"].as<unsigned>( );
+      if (pipe.parallelism == 0) {
+        throw std::runtime_error{ "The parallelism of pipeline " + pipe.name + " must be at least 1" };
+      }
+    }
+    if (node["partition"]) {
+      pipe.partition = node["partition"].as<std::string>( );
+      try {
+        nlohmann::json::json_pointer{ pipe.partition };
+      } catch (const nlohmann::json::exception& e) {
+        throw std::runtime_error{ "The partition of pipeline " + pipe.name + " is not a JSON pointer: " + e.what( ) };
+      }
+      if (pipe.parallelism == 1) {
+        throw std::runtime_error{ "The partition of pipeline " + pipe.name + " needs a parallelism above 1" };
+      }
+    }
+    // Partitioned stages keep the order per key, the order over all keys is only kept when asked for
+    pipe.ordered = node["ordered"] ? node["ordered"].as<bool>( ) : pipe.partition.empty( );
     return true;
   }
 };
@@ -133,6 +168,9 @@ struct convert<trawler::config::buffer_pipeline_t>
   static bool decode(const Node& node, trawler::config::buffer_pipeline_t& pipe)
   {
     convert<trawler::config::pipeline_t>::decode(node, pipe);
+    if (!pipe.partition.empty( )) {
+      throw std::runtime_error{ "Buffer pipeline " + pipe.name + " can't be partitioned" };
+    }
     pipe.trigger_source = node["trigger_source"].as<std::string>( );
 
     if (auto events = get_events(node, "trigger_event")) {
@@ -168,10 +206,94 @@ struct convert<trawler::config::http_client_pipeline_t>
     if (node["ssl"]) {
       pipe.ssl = node["ssl"].as<bool>( );
     }
+    if (node["max_in_flight"]) {
+      pipe.max_in_flight = node["max_in_flight"].as<std::size_t>( );
+    }
+    if (node["coalesce"]) {
+      pipe.coalesce = node["coalesce"].as<bool>( );
+    }
+    if (node["cache_bytes"]) {
+      pipe.cache_bytes = node["cache_bytes"].as<std::size_t>( );
+    }
+    if (node["retries"]) {
+      pipe.retries = node["retries"].as<std::size_t>( );
+    }
+    if (node["retry_backoff_ms"]) {
+      pipe.retry_backoff_ms = node["retry_backoff_ms"].as<unsigned>( );
+    }
+    if (node["hedge_percentile"]) {
+      pipe.hedge_percentile = node["hedge_percentile"].as<double>( );
+    }
+    if (node["hedge_delay_ms"]) {
+      pipe.hedge_delay_ms = node["hedge_delay_ms"].as<unsigned>( );
+    }
+    if (node["max_body_bytes"]) {
+      pipe.max_body_bytes = node["max_body_bytes"].as<std::size_t>( );
+    }
+    if (node["streaming"]) {
+      pipe.streaming = node["streaming"].as<std::string>( );
+      if (pipe.streaming != "none" && pipe.streaming != "ndjson" && pipe.streaming != "json-array") {
+        throw std::runtime_error{ "Unknown streaming mode " + pipe.streaming };
+      }
+    }
     return convert<trawler::config::pipeline_t>::decode(node, pipe);
   }
 };
 
+/*******************************************************************************
+ * convert http_scatter_gather_pipeline_t
+ *******************************************************************************/
+template<>
+struct convert<trawler::config::http_scatter_gather_pipeline_t>
+{
+  static bool decode(const Node& node, trawler::config::http_scatter_gather_pipeline_t& pipe)
+  {
+    if (node["timeout_ms"]) {
+      pipe.timeout_ms = node["timeout_ms"].as<unsigned>( );
+    }
+    return convert<trawler::config::http_client_pipeline_t>::decode(node, pipe);
+  }
+};
+
+/*******************************************************************************
+ * convert resolver_t
+ *******************************************************************************/
+template<>
+struct convert<trawler::config::resolver_t>
+{
+  static bool decode(const Node& node, trawler::config::resolver_t& resolver)
+  {
+    if (node["ttl"]) {
+      resolver.ttl = node["ttl"].as<unsigned>( );
+    }
+    if (node["negative_ttl"]) {
+      resolver.negative_ttl = node["negative_ttl"].as<unsigned>( );
+    }
+    return true;
+  }
+};
+
+/*******************************************************************************
+ * convert threads_t
+ *******************************************************************************/
+template<>
+struct convert<trawler::config::threads_t>
+{
+  static bool decode(const Node& node, trawler::config::threads_t& threads)
+  {
+    if (node["session"]) {
+      threads.session = node["session"].as<unsigned>( );
+    }
+    if (node["service"]) {
+      threads.service = node["service"].as<unsigned>( );
+    }
+    if (node["sharded"]) {
+      threads.sharded = node["sharded"].as<bool>( );
+    }
+    return true;
+  }
+};
+
 /*******************************************************************************
  * convert configuration_t
  *******************************************************************************/
@@ -188,6 +310,14 @@ struct convert<trawler::configuration_t>
     decode_pipelines(node, config);
     decode_endpoints(node, config);
 
+    if (node["resolver"]) {
+      config.resolver = node["resolver"].as<trawler::config::resolver_t>( );
+    }
+
+    if (node["threads"]) {
+      config.threads = node["threads"].as<trawler::config::threads_t>( );
+    }
+
     return true;
   }
 
@@ -216,6 +346,8 @@ struct convert<trawler::configuration_t>
         config.pipelines.emplace_back(pipe.as<trawler::config::emit_pipeline_t>( ));
       } else if (pipe.IsMap( ) && pipe["pipeline"].as<std::string>( ) == "http-client") {
         config.pipelines.emplace_back(pipe.as<trawler::config::http_client_pipeline_t>( ));
+      } else if (pipe.IsMap( ) && pipe["pipeline"].as<std::string>( ) == "http-scatter-gather") {
+        config.pipelines.emplace_back(pipe.as<trawler::config::http_scatter_gather_pipeline_t>( ));
       }
     }
   }
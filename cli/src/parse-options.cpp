@@ -15,7 +15,11 @@ parse_options(int argc, const char* argv[])
 
   po::options_description desc{ "Options" };
   desc.add_options( )("help,h", "print usage")(
-    "loglevel", po::value<std::string>()->default_value("info"), "debug|info|critical");
+    "loglevel", po::value<std::string>()->default_value("info"), "debug|info|critical")(
+    "session-threads", po::value<unsigned>( ), "threads doing network i/o, 0 for one per core")(
+    "service-threads", po::value<unsigned>( ), "threads running the pipelines, 0 for one per core")(
+    "sharded", po::bool_switch( ), "give every session thread its own connections")(
+    "workers", po::value<unsigned>( ), "run in this many processes, restarting any that crash");
   
   po::options_description hidden{ "Hidden options" };
   hidden.add_options( )("config", po::value<std::vector<std::string>>( ), "configuration file");
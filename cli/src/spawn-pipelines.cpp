@@ -1,11 +1,17 @@
 #include "overloaded.hpp"
+#include <map>
+#include <nlohmann/json.hpp>
+#include <optional>
 #include <trawler/cli/spawn-pipelines.hpp>
 #include <trawler/pipelines/buffer/buffer.hpp>
 #include <trawler/pipelines/emit/emit.hpp>
 #include <trawler/pipelines/endpoint/endpoint.hpp>
 #include <trawler/pipelines/http-client/http-client.hpp>
+#include <trawler/pipelines/http-client/scatter-gather.hpp>
 #include <trawler/pipelines/inja/inja.hpp>
 #include <trawler/pipelines/jq/jq.hpp>
+#include <trawler/services/dataflow.hpp>
+#include <trawler/services/service-context.hpp>
 
 namespace trawler {
 
@@ -38,27 +44,151 @@ make_event_filter(std::vector<ServicePacket::EStatus> accept)
   };
 }
 
+// Packets past their deadline are expired rather than processed, nobody is waiting for the answer anymore
+bool
+expire_if_past_deadline(const ServicePacket& service_packet)
+{
+  if (service_packet.is_expired( )) {
+    service_packet.expire( );
+    return true;
+  }
+  return false;
+}
+
 auto
-make_inja_visitor(const services_t& services, pipelines_t& pipelines, const Logger& logger)
+make_stage_filter(std::vector<ServicePacket::EStatus> accept)
+{
+  return [accept_event = make_event_filter(std::move(accept))](const ServicePacket& service_packet) {
+    return accept_event(service_packet) && !expire_if_past_deadline(service_packet);
+  };
+}
+
+// Where the output of a stage run on the dataflow runtime is pushed to
+struct dataflow_port_t
+{
+  std::shared_ptr<DataflowSource> source;
+  std::shared_ptr<DataflowOutputs> outputs;
+};
+
+using dataflow_ports_t = std::map<std::string, dataflow_port_t>;
+
+// The outputs a stage on the dataflow runtime reading from name is wired to. Stages reading from a service or any
+// pipeline not on the runtime share one subscription to it.
+dataflow_port_t
+get_dataflow_upstream(const services_t& services,
+                      const pipelines_t& pipelines,
+                      dataflow_ports_t& ports,
+                      const std::string& name)
+{
+  auto upstream = ports.find(name);
+  if (upstream == end(ports)) {
+    auto source = std::make_shared<DataflowSource>(find_source(services, pipelines, name));
+    upstream = ports.emplace(name, dataflow_port_t{ source, source->get_outputs( ) }).first;
+  }
+  return upstream->second;
+}
+
+void
+add_dataflow_port(pipelines_t& pipelines, dataflow_ports_t& ports, const std::string& name, dataflow_port_t port)
+{
+  pipelines.push_back({ name, make_dataflow_observable(port.source, port.outputs) });
+  ports.emplace(name, std::move(port));
+}
+
+// Runs a stage on the service threads for up to pipe.parallelism packets at once, one at a time per partition key
+void
+add_parallel_stage(const std::shared_ptr<ServiceContext>& context,
+                   const services_t& services,
+                   pipelines_t& pipelines,
+                   dataflow_ports_t& ports,
+                   const config::pipeline_t& pipe,
+                   ParallelNode::task_t task)
+{
+  const auto upstream = get_dataflow_upstream(services, pipelines, ports, pipe.source);
+
+  // Filtered before the hop to the service threads, so dropped packets don't take up a worker
+  auto filter = make_dataflow_node([accept = make_stage_filter(pipe.event)](const ServicePacket& packet,
+                                                                             PacketSink& outputs) {
+    if (accept(packet)) {
+      outputs.push(packet);
+    }
+  });
+  auto node = std::make_shared<ParallelNode>(
+    context->get_service_context( ), pipe.parallelism, pipe.ordered, std::move(task), make_json_partition(pipe.partition));
+  upstream.outputs->connect(filter);
+  filter->get_outputs( )->connect(node);
+  add_dataflow_port(pipelines, ports, pipe.name, { upstream.source, node->get_outputs( ) });
+}
+
+// Runs a stage on the push based dataflow runtime, wired directly to its source when that is on the runtime too
+template<typename Stage>
+void
+add_dataflow_stage(const std::shared_ptr<ServiceContext>& context,
+                   const services_t& services,
+                   pipelines_t& pipelines,
+                   dataflow_ports_t& ports,
+                   const config::pipeline_t& pipe,
+                   Stage stage)
+{
+  if (pipe.parallelism > 1) {
+    add_parallel_stage(context, services, pipelines, ports, pipe, make_parallel_task(std::move(stage)));
+    return;
+  }
+
+  const auto upstream = get_dataflow_upstream(services, pipelines, ports, pipe.source);
+  auto filtered = [accept = make_stage_filter(pipe.event), stage = std::move(stage)](const ServicePacket& packet,
+                                                                                       PacketSink& outputs) {
+    if (accept(packet)) {
+      stage(packet, outputs);
+    }
+  };
+  auto node = make_dataflow_node(std::move(filtered));
+  upstream.outputs->connect(node);
+  add_dataflow_port(pipelines, ports, pipe.name, { upstream.source, node->get_outputs( ) });
+}
+
+// A dataflow stage pushing one packet for every packet
+auto
+make_map_stage(std::function<ServicePacket(ServicePacket)> transform)
+{
+  return [transform = std::move(transform)](const ServicePacket& packet, PacketSink& outputs) {
+    outputs.push(transform(packet));
+  };
+}
+
+auto
+make_jq_stage(jq_stage_t jq)
+{
+  return [jq = std::move(jq)](const ServicePacket& packet, PacketSink& outputs) {
+    jq(packet, [&outputs](const ServicePacket& result) { outputs.push(result); });
+  };
+}
+
+auto
+make_inja_visitor(const std::shared_ptr<ServiceContext>& context,
+                  const services_t& services,
+                  pipelines_t& pipelines,
+                  dataflow_ports_t& ports,
+                  const Logger& logger)
 {
   return [&](const config::inja_pipeline_t& pipe) {
     logger.info("Creating pipeline " + pipe.pipeline + " [" + pipe.name + "]");
-    const auto source = find_source(services, pipelines, pipe.source).filter(make_event_filter(pipe.event));
     const auto transform = create_inja_pipeline(pipe.tmplate, { pipe.name });
-    auto observer = source.map(transform).as_dynamic( );
-    pipelines.push_back({ pipe.name, std::move(observer) });
+    add_dataflow_stage(context, services, pipelines, ports, pipe, make_map_stage(transform));
   };
 }
 
 auto
-make_jq_visitor(const services_t& services, pipelines_t& pipelines, const Logger& logger)
+make_jq_visitor(const std::shared_ptr<ServiceContext>& context,
+                const services_t& services,
+                pipelines_t& pipelines,
+                dataflow_ports_t& ports,
+                const Logger& logger)
 {
   return [&](const config::jq_pipeline_t& pipe) {
     logger.info("Creating pipeline " + pipe.pipeline + " [" + pipe.name + "]");
-    const auto source = find_source(services, pipelines, pipe.source).filter(make_event_filter(pipe.event));
-    const auto transform = create_jq_pipeline(pipe.script, { pipe.name });
-    auto observer = source.flat_map(transform).as_dynamic( );
-    pipelines.push_back({ pipe.name, std::move(observer) });
+    auto jq = create_jq_stage(pipe.script, { pipe.name });
+    add_dataflow_stage(context, services, pipelines, ports, pipe, make_jq_stage(std::move(jq)));
   };
 }
 
@@ -67,61 +197,201 @@ make_buffer_visitor(const services_t& services, pipelines_t& pipelines, const Lo
 {
   return [&](const config::buffer_pipeline_t& pipe) {
     logger.info("Creating pipeline " + pipe.pipeline + " [" + pipe.name + "]");
-    const auto source = find_source(services, pipelines, pipe.source).filter(make_event_filter(pipe.event));
-    const auto trigger = find_source(services, pipelines, pipe.trigger_source).filter(make_event_filter(pipe.trigger_event));
+    const auto source = find_source(services, pipelines, pipe.source).filter(make_stage_filter(pipe.event));
+    const auto trigger = find_source(services, pipelines, pipe.trigger_source).filter(make_stage_filter(pipe.trigger_event));
     auto observer = create_buffer_pipeline(std::move(trigger), std::move(source), logger).as_dynamic( );
     pipelines.push_back({ pipe.name, std::move(observer) });
   };
 }
 
 auto
-make_emit_visitor(const services_t& services, pipelines_t& pipelines, const Logger& logger)
+make_emit_visitor(const std::shared_ptr<ServiceContext>& context,
+                  const services_t& services,
+                  pipelines_t& pipelines,
+                  dataflow_ports_t& ports,
+                  const Logger& logger)
 {
   return [&](const config::emit_pipeline_t& pipe) {
     logger.info("Creating pipeline " + pipe.pipeline + " [" + pipe.name + "]");
-    const auto source = find_source(services, pipelines, pipe.source).filter(make_event_filter(pipe.event));
     const auto transform = create_emit_pipeline(pipe.data, { pipe.name });
-    auto observer = source.map(transform).as_dynamic( );
-    pipelines.push_back({ pipe.name, std::move(observer) });
+    add_dataflow_stage(context, services, pipelines, ports, pipe, make_map_stage(transform));
+  };
+}
+
+// Applies map stages one after the other within a single call. The deadline is checked before every stage, like the
+// filter in front of an unfused stage does, and nothing is returned for a packet past it
+auto
+compose_map_stages(std::vector<std::function<ServicePacket(ServicePacket)>> stages)
+{
+  return [stages = std::move(stages)](ServicePacket packet) -> std::optional<ServicePacket> {
+    for (const auto& stage : stages) {
+      if (expire_if_past_deadline(packet)) {
+        return std::nullopt;
+      }
+      packet = stage(std::move(packet));
+    }
+    return packet;
+  };
+}
+
+auto
+make_fused_visitor(const std::shared_ptr<ServiceContext>& context,
+                   const services_t& services,
+                   pipelines_t& pipelines,
+                   dataflow_ports_t& ports,
+                   const Logger& logger)
+{
+  return [&](const config::fused_pipeline_t& pipe) {
+    logger.info("Creating pipeline of " + std::to_string(pipe.stages.size( )) + " fused stages [" + pipe.name + "]");
+    auto jq = jq_stage_t{ };
+    auto before = std::vector<std::function<ServicePacket(ServicePacket)>>{ };
+    auto after = std::vector<std::function<ServicePacket(ServicePacket)>>{ };
+    const auto stage_visitor = overloaded{
+      [&](const config::jq_pipeline_t& stage) { jq = create_jq_stage(stage.script, { stage.name }); },
+      [&](const config::inja_pipeline_t& stage) {
+        (jq ? after : before).push_back(create_inja_pipeline(stage.tmplate, { stage.name }));
+      },
+      [&](const config::emit_pipeline_t& stage) {
+        (jq ? after : before).push_back(create_emit_pipeline(stage.data, { stage.name }));
+      },
+    };
+    for (const auto& stage : pipe.stages) {
+      std::visit(stage_visitor, stage);
+    }
+
+    const auto map_before = compose_map_stages(std::move(before));
+    if (!jq) {
+      auto fused = [=](const ServicePacket& packet, PacketSink& outputs) {
+        if (auto result = map_before(packet)) {
+          outputs.push(*result);
+        }
+      };
+      add_dataflow_stage(context, services, pipelines, ports, pipe, std::move(fused));
+      return;
+    }
+
+    const auto map_after = compose_map_stages(std::move(after));
+    auto fused = [=](const ServicePacket& packet, PacketSink& outputs) {
+      const auto mapped = map_before(packet);
+      if (!mapped || expire_if_past_deadline(*mapped)) {
+        return;
+      }
+      jq(*mapped, [&](const ServicePacket& result) {
+        if (auto output = map_after(result)) {
+          outputs.push(*output);
+        }
+      });
+    };
+    add_dataflow_stage(context, services, pipelines, ports, pipe, std::move(fused));
   };
 }
 
+http_client_options_t
+make_http_client_options(const config::http_client_pipeline_t& pipe, const std::shared_ptr<HttpConnectionPool>& pool)
+{
+  auto options = http_client_options_t{ };
+  options.ssl = pipe.ssl;
+  options.max_in_flight = pipe.max_in_flight;
+  options.coalesce = pipe.coalesce;
+  options.cache_bytes = pipe.cache_bytes;
+  options.retries = pipe.retries;
+  options.retry_backoff = std::chrono::milliseconds{ pipe.retry_backoff_ms };
+  options.hedge_percentile = pipe.hedge_percentile;
+  options.hedge_delay = std::chrono::milliseconds{ pipe.hedge_delay_ms };
+  options.max_body_bytes = pipe.max_body_bytes;
+  if (pipe.streaming == "ndjson") {
+    options.streaming = EHttpStreaming::NDJSON;
+  } else if (pipe.streaming == "json-array") {
+    options.streaming = EHttpStreaming::JSON_ARRAY;
+  }
+  options.pool = pool;
+  return options;
+}
+
 auto
-make_http_client_visitor(const services_t& services, pipelines_t& pipelines, const Logger& logger)
+make_http_client_visitor(const std::shared_ptr<ServiceContext>& context,
+                         const std::shared_ptr<HttpConnectionPool>& pool,
+                         const services_t& services,
+                         pipelines_t& pipelines,
+                         dataflow_ports_t& ports,
+                         const Logger& logger)
 {
   return [&](const config::http_client_pipeline_t& pipe) {
     logger.info("Creating pipeline " + pipe.pipeline + " [" + pipe.name + "]");
-    const auto source = find_source(services, pipelines, pipe.source).filter(make_event_filter(pipe.event));
-    const auto transform = pipe.ssl
-      ? create_http_client_ssl_pipeline({ pipe.name })
-      : create_http_client_pipeline({ pipe.name });
-    auto observer = source.map(transform).as_dynamic( );
+    const auto options = make_http_client_options(pipe, pool);
+    const auto transform = create_http_client_pipeline(context, options, { pipe.name });
+    if (pipe.parallelism > 1) {
+      add_parallel_stage(context, services, pipelines, ports, pipe, make_observable_task(transform));
+      return;
+    }
+    const auto source = find_source(services, pipelines, pipe.source).filter(make_stage_filter(pipe.event));
+    auto observer = source.flat_map(transform).as_dynamic( );
+    pipelines.push_back({ pipe.name, std::move(observer) });
+  };
+}
+
+auto
+make_http_scatter_gather_visitor(const std::shared_ptr<ServiceContext>& context,
+                                 const std::shared_ptr<HttpConnectionPool>& pool,
+                                 const services_t& services,
+                                 pipelines_t& pipelines,
+                                 dataflow_ports_t& ports,
+                                 const Logger& logger)
+{
+  return [&](const config::http_scatter_gather_pipeline_t& pipe) {
+    logger.info("Creating pipeline " + pipe.pipeline + " [" + pipe.name + "]");
+    auto options = http_scatter_gather_options_t{ };
+    options.client = make_http_client_options(pipe, pool);
+    options.timeout = std::chrono::milliseconds{ pipe.timeout_ms };
+    const auto transform = create_http_scatter_gather_pipeline(context, options, { pipe.name });
+    if (pipe.parallelism > 1) {
+      add_parallel_stage(context, services, pipelines, ports, pipe, make_observable_task(transform));
+      return;
+    }
+    const auto source = find_source(services, pipelines, pipe.source).filter(make_stage_filter(pipe.event));
+    auto observer = source.flat_map(transform).as_dynamic( );
     pipelines.push_back({ pipe.name, std::move(observer) });
   };
 }
 
 pipelines_t
-spawn_pipelines(const services_t& services,
+spawn_pipelines(const std::shared_ptr<ServiceContext>& context,
+                const services_t& services,
                 const std::vector<configuration_t::pipeline_t>& pipeline_config,
                 const Logger& logger)
 {
   logger.debug("Spawning pipelines");
   auto pipelines = pipelines_t{};
+  auto ports = dataflow_ports_t{ };
 
-  const auto inja_visitor = make_inja_visitor(services, pipelines, logger);
-  const auto jq_visitor = make_jq_visitor(services, pipelines, logger);
+  const auto inja_visitor = make_inja_visitor(context, services, pipelines, ports, logger);
+  const auto jq_visitor = make_jq_visitor(context, services, pipelines, ports, logger);
   const auto buffer_visitor = make_buffer_visitor(services, pipelines, logger);
-  const auto emit_visitor = make_emit_visitor(services, pipelines, logger);
-  const auto http_client_visitor = make_http_client_visitor(services, pipelines, logger);
+  const auto emit_visitor = make_emit_visitor(context, services, pipelines, ports, logger);
+  const auto fused_visitor = make_fused_visitor(context, services, pipelines, ports, logger);
+  // All http-client pipelines share keep-alive connections to their upstreams
+  const auto http_client_pool = std::make_shared<HttpConnectionPool>( );
+  const auto http_client_visitor =
+    make_http_client_visitor(context, http_client_pool, services, pipelines, ports, logger);
+  const auto http_scatter_gather_visitor =
+    make_http_scatter_gather_visitor(context, http_client_pool, services, pipelines, ports, logger);
 
   const auto visitor = overloaded{ std::move(inja_visitor),
                                    std::move(jq_visitor),
                                    std::move(buffer_visitor),
                                    std::move(emit_visitor),
-                                   std::move(http_client_visitor) };
+                                   std::move(fused_visitor),
+                                   std::move(http_client_visitor),
+                                   std::move(http_scatter_gather_visitor) };
 
   for (const configuration_t::pipeline_t& pipe : pipeline_config) {
     std::visit(visitor, pipe);
+    // Multicast the output, just like the services, so a stage runs once per packet however many consumers it has.
+    // Stages on the dataflow runtime fan out by themselves.
+    auto& [name, output] = pipelines.back( );
+    if (!ports.count(name)) {
+      output = output.publish( ).ref_count( ).as_dynamic( );
+    }
   }
 
   return pipelines;
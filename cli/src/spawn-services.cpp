@@ -14,13 +14,15 @@ make_websocket_client_visitor(const std::shared_ptr<ServiceContext>& context, so
   return [&](const config::websocket_client_service_t& service) {
     if (service.ssl) {
       logger.info("Creating websocket ssl client [" + service.name + "]");
-      auto client = create_websocket_client_ssl(context, service.host, service.port, service.target, { service.name })
+      auto client = create_websocket_client_ssl(
+                      context, service.host, service.port, service.target, { service.name }, service.run_to_completion)
                       .publish( )
                       .ref_count( );
       sources.emplace_back(service.name, std::move(client));
     } else {
       logger.info("Creating websocket client [" + service.name + "]");
-      auto client = create_websocket_client(context, service.host, service.port, service.target, { service.name })
+      auto client = create_websocket_client(
+                      context, service.host, service.port, service.target, { service.name }, service.run_to_completion)
                       .publish( )
                       .ref_count( );
       sources.emplace_back(service.name, std::move(client));
@@ -33,7 +35,11 @@ make_http_server_visitor(const std::shared_ptr<ServiceContext>& context, sources
 {
   return [&](const config::http_server_service_t& service) {
     logger.info("Creating http server [" + service.name + "]");
-    auto server = create_http_server(context, service.host, service.port, { service.name }).publish( ).ref_count( );
+    auto options = http_server_options_t{ std::chrono::milliseconds{ service.timeout_ms }, service.acceptors };
+    options.reuse_port = service.reuse_port;
+    options.run_to_completion = service.run_to_completion;
+    auto server =
+      create_http_server(context, service.host, service.port, options, { service.name }).publish( ).ref_count( );
     sources.emplace_back(service.name, std::move(server));
   };
 }
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <map>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <trawler/cli/supervise-workers.hpp>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace trawler {
+
+namespace {
+
+struct worker_t
+{
+  std::size_t index;
+  std::chrono::steady_clock::time_point started;
+  // How many times in a row the worker crashed sooner than the restart delay after it was started
+  std::size_t fast_failures;
+};
+
+std::string
+describe_exit(int status)
+{
+  if (WIFSIGNALED(status)) {
+    return "was killed by signal " + std::to_string(WTERMSIG(status));
+  }
+  return "exited with " + std::to_string(WEXITSTATUS(status));
+}
+
+// Waits for one of signals, or until deadline if there is one. Returns the signal, or 0 if the deadline passed
+int
+wait_for_signal(const sigset_t& signals, std::optional<std::chrono::steady_clock::time_point> deadline)
+{
+  if (!deadline) {
+    return sigwaitinfo(&signals, nullptr);
+  }
+  const auto timeout = std::max(*deadline - std::chrono::steady_clock::now( ), std::chrono::steady_clock::duration{ });
+  const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+  const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds);
+  const auto spec = timespec{ static_cast<time_t>(seconds.count( )), static_cast<long>(nanoseconds.count( )) };
+  const auto signal = sigtimedwait(&signals, nullptr, &spec);
+  return signal < 0 && errno == EAGAIN ? 0 : signal;
+}
+}
+
+int
+supervise_workers(std::size_t nof_workers,
+                  const std::function<int(std::size_t)>& worker,
+                  const Logger& logger,
+                  std::chrono::milliseconds restart_delay,
+                  std::size_t max_fast_failures)
+{
+  using clock_t = std::chrono::steady_clock;
+
+  // The signals are blocked and waited for rather than handled, so one arriving while the supervisor is busy is
+  // still pending when it waits next
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGCHLD);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigset_t previous_mask;
+  sigprocmask(SIG_BLOCK, &signals, &previous_mask);
+
+  auto workers = std::map<pid_t, worker_t>{ };
+  // Workers waiting for their restart delay to pass, in no particular order
+  auto restarts = std::vector<std::pair<clock_t::time_point, worker_t>>{ };
+
+  auto spawn = [&](std::size_t index, std::size_t fast_failures) {
+    // Output still buffered would otherwise be written by both processes
+    std::fflush(nullptr);
+    const auto pid = fork( );
+    if (pid == 0) {
+      sigprocmask(SIG_SETMASK, &previous_mask, nullptr);
+      auto exit_code = 1;
+      try {
+        exit_code = worker(index);
+      } catch (const std::exception& e) {
+        logger.critical("Worker " + std::to_string(index) + " failed: " + e.what( ));
+      } catch (...) {
+        logger.critical("Worker " + std::to_string(index) + " failed");
+      }
+      // Leave the state inherited from the supervisor alone, only the output of the worker needs flushing
+      std::fflush(nullptr);
+      std::_Exit(exit_code);
+    }
+    if (pid < 0) {
+      logger.critical("Failed to start worker " + std::to_string(index) + ": " + std::strerror(errno));
+      return false;
+    }
+    logger.info("Started worker " + std::to_string(index) + " as process " + std::to_string(pid));
+    workers[pid] = { index, clock_t::now( ), fast_failures };
+    return true;
+  };
+
+  auto result = 0;
+  for (auto index = std::size_t{ 0 }; index < nof_workers; ++index) {
+    if (!spawn(index, 0)) {
+      result = 1;
+    }
+  }
+
+  auto stopping = false;
+  auto on_exit = [&](pid_t pid, int status) {
+    const auto found = workers.find(pid);
+    if (found == end(workers)) {
+      return;
+    }
+    const auto exited = found->second;
+    workers.erase(found);
+
+    // Workers stopped by the SIGTERM passed on to them stopped as asked
+    const auto stopped = stopping && WIFSIGNALED(status) && WTERMSIG(status) == SIGTERM;
+    const auto succeeded = (WIFEXITED(status) && WEXITSTATUS(status) == 0) || stopped;
+    if (succeeded || stopping) {
+      logger.info("Worker " + std::to_string(exited.index) + " " + describe_exit(status));
+      result = succeeded ? result : 1;
+      return;
+    }
+
+    // Don't spin on a worker crashing right away, there's likely nothing a restart can do about it
+    const auto restart_at = exited.started + restart_delay;
+    const auto fast_failures = clock_t::now( ) < restart_at ? exited.fast_failures + 1 : 0;
+    if (max_fast_failures > 0 && fast_failures >= max_fast_failures) {
+      logger.critical("Worker " + std::to_string(exited.index) + " " + describe_exit(status) + " " +
+                      std::to_string(fast_failures) + " times in a row right after starting, giving up on it");
+      result = 1;
+      return;
+    }
+    logger.critical("Worker " + std::to_string(exited.index) + " " + describe_exit(status) + ", restarting it");
+    restarts.emplace_back(restart_at, worker_t{ exited.index, { }, fast_failures });
+  };
+
+  while (!workers.empty( ) || !restarts.empty( )) {
+    auto status = 0;
+    auto pid = waitpid(-1, &status, WNOHANG);
+    for (; pid > 0; pid = waitpid(-1, &status, WNOHANG)) {
+      on_exit(pid, status);
+    }
+    if (pid < 0 && !(errno == ECHILD && workers.empty( ))) {
+      logger.critical(std::string{ "Failed to wait for workers: " } + std::strerror(errno));
+      result = 1;
+      break;
+    }
+
+    const auto now = clock_t::now( );
+    auto next_restart = std::optional<clock_t::time_point>{ };
+    for (auto restart = begin(restarts); restart != end(restarts);) {
+      if (restart->first > now) {
+        next_restart = next_restart ? std::min(*next_restart, restart->first) : restart->first;
+        ++restart;
+        continue;
+      }
+      if (!spawn(restart->second.index, restart->second.fast_failures)) {
+        result = 1;
+      }
+      restart = restarts.erase(restart);
+    }
+
+    if (workers.empty( ) && restarts.empty( )) {
+      break;
+    }
+
+    const auto signal = wait_for_signal(signals, next_restart);
+    if ((signal == SIGINT || signal == SIGTERM) && !stopping) {
+      logger.info("Stopping workers");
+      stopping = true;
+      // Workers waiting for their restart crashed the last time they ran
+      result = restarts.empty( ) ? result : 1;
+      restarts.clear( );
+      for (const auto& [pid, worker] : workers) {
+        kill(pid, SIGTERM);
+      }
+    }
+  }
+
+  sigprocmask(SIG_SETMASK, &previous_mask, nullptr);
+  return result;
+}
+}
@@ -1,11 +1,17 @@
+#include <algorithm>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <trawler/cli/optimize-configuration.hpp>
 #include <trawler/cli/parse-configuration.hpp>
 #include <trawler/cli/parse-options.hpp>
 #include <trawler/cli/spawn-endpoints.hpp>
 #include <trawler/cli/spawn-pipelines.hpp>
 #include <trawler/cli/spawn-services.hpp>
+#include <trawler/cli/supervise-workers.hpp>
 #include <trawler/logging/logger.hpp>
 #include <trawler/services/service-context.hpp>
 #include <vector>
@@ -59,6 +65,41 @@ configure_loglevel(const std::string& loglevel)
   return std::make_exception_ptr(std::runtime_error{ "unknown loglevel " + loglevel });
 }
 
+// Thread counts given on the command line take precedence over the configuration file
+config::threads_t
+configure_threads(const boost::program_options::variables_map& vm, config::threads_t threads)
+{
+  if (vm.count("session-threads")) {
+    threads.session = vm["session-threads"].as<unsigned>( );
+  }
+  if (vm.count("service-threads")) {
+    threads.service = vm["service-threads"].as<unsigned>( );
+  }
+  if (vm.count("sharded") && vm["sharded"].as<bool>( )) {
+    threads.sharded = true;
+  }
+
+  const auto nof_cores = std::max(std::thread::hardware_concurrency( ), 1U);
+  threads.session = threads.session > 0 ? threads.session : nof_cores;
+  threads.service = threads.service > 0 ? threads.service : nof_cores;
+  return threads;
+}
+
+// Parallel stages run on the service threads, none of them may need more than there are
+std::exception_ptr
+check_service_threads(const config::threads_t& threads, const configuration_t& configuration)
+{
+  for (const auto& pipe : configuration.pipelines) {
+    const auto& stage = std::visit([](const auto& p) -> const config::pipeline_t& { return p; }, pipe);
+    if (stage.parallelism > threads.service) {
+      return std::make_exception_ptr(std::runtime_error{ "Pipeline " + stage.name + " has a parallelism of " +
+                                                         std::to_string(stage.parallelism) + " but there are only " +
+                                                         std::to_string(threads.service) + " service threads" });
+    }
+  }
+  return nullptr;
+}
+
 template<typename TimeDelta>
 void
 wait_for_unsubscribe(std::vector<rxcpp::subscription>& subscriptions, TimeDelta timeout)
@@ -85,6 +126,26 @@ wait_for_unsubscribe(std::vector<rxcpp::subscription>& subscriptions)
   wait_for_unsubscribe(subscriptions, 0ms);
 }
 
+// Runs the services, pipelines and endpoints of the configuration until the endpoints are done
+void
+run(const configuration_t& configuration, const config::threads_t& threads, const Logger& logger)
+{
+  const auto threading = threads.sharded ? ESessionThreading::SHARDED : ESessionThreading::SHARED;
+  logger.info("Running " + std::to_string(threads.session) + (threads.sharded ? " sharded" : "") +
+              " session threads and " + std::to_string(threads.service) + " service threads");
+  auto context = make_service_context(threads.session, threads.service, threading);
+  context->get_resolver_cache( ).set_ttl(std::chrono::seconds{ configuration.resolver.ttl },
+                                         std::chrono::seconds{ configuration.resolver.negative_ttl });
+
+  auto services = spawn_services(context, configuration.services, logger);
+
+  auto pipelines = spawn_pipelines(context, services, configuration.pipelines, logger);
+
+  auto subscriptions = spawn_endpoints(services, pipelines, configuration.endpoints, logger);
+
+  wait_for_unsubscribe(subscriptions);
+}
+
 int
 main(int argc, const char* argv[]) // NOLINT(readability-function-size)
 {
@@ -134,17 +195,36 @@ main(int argc, const char* argv[]) // NOLINT(readability-function-size)
     }
   }
 
-  const auto configuration = parse_configuration(configuration_string);
-
-  auto context = make_service_context( );
-
-  auto services = spawn_services(context, configuration.services, logger);
-
-  auto pipelines = spawn_pipelines(services, configuration.pipelines, logger);
+  auto configuration = optimize_configuration(parse_configuration(configuration_string), { "optimizer" });
+  const auto threads = configure_threads(vm, configuration.threads);
+  {
+    const auto err = check_service_threads(threads, configuration);
+    if (err) {
+      print_usage(std::cerr, description);
+      print_exception(err);
+      return 5;
+    }
+  }
 
-  auto subscriptions = spawn_endpoints(services, pipelines, configuration.endpoints, logger);
+  const auto nof_workers = vm.count("workers") ? vm["workers"].as<unsigned>( ) : 0U;
+  if (nof_workers == 0) {
+    run(configuration, threads, logger);
+    return 0;
+  }
 
-  wait_for_unsubscribe(subscriptions);
+  // Every worker listens on the ports of the http servers itself, the kernel spreads the connections over them
+  for (auto& service : configuration.services) {
+    if (auto* http_server = std::get_if<config::http_server_service_t>(&service)) {
+      http_server->reuse_port = true;
+    }
+  }
 
-  return 0;
+  logger.info("Running " + std::to_string(nof_workers) + " worker processes");
+  return supervise_workers(
+    nof_workers,
+    [&](std::size_t) {
+      run(configuration, threads, logger);
+      return 0;
+    },
+    logger);
 }
@@ -27,6 +27,8 @@ public:
   void info(const std::string&) const;
   void critical(const std::string&) const;
 
+  bool should_log(ELogLevel) const;
+
   const std::string& get_label( ) const;
 
   static void set_log_level(ELogLevel);
@@ -5,6 +5,24 @@
 
 namespace trawler {
 
+namespace {
+
+spdlog::level::level_enum
+to_spdlog_level(Logger::ELogLevel level)
+{
+  switch (level) {
+    case Logger::ELogLevel::CRITICAL:
+      return spdlog::level::critical;
+    case Logger::ELogLevel::INFO:
+      return spdlog::level::info;
+    case Logger::ELogLevel::DEBUG:
+      return spdlog::level::debug;
+    default:
+      throw std::runtime_error("Unknown log level");
+  }
+}
+}
+
 class LoggerBackend
   : public spdlog::logger
   , public std::enable_shared_from_this<LoggerBackend>
@@ -54,6 +72,12 @@ Logger::debug(const std::string& s) const
   }
 }
 
+bool
+Logger::should_log(ELogLevel level) const
+{
+  return backend && backend->should_log(to_spdlog_level(level));
+}
+
 const std::string&
 Logger::get_label( ) const
 {
@@ -63,18 +87,6 @@ Logger::get_label( ) const
 void
 Logger::set_log_level(ELogLevel level)
 {
-  switch (level) {
-    case ELogLevel::CRITICAL:
-      spdlog::set_level(spdlog::level::critical);
-      break;
-    case ELogLevel::INFO:
-      spdlog::set_level(spdlog::level::info);
-      break;
-    case ELogLevel::DEBUG:
-      spdlog::set_level(spdlog::level::debug);
-      break;
-    default:
-      throw std::runtime_error("Unknown log level");
-  }
+  spdlog::set_level(to_spdlog_level(level));
 }
 }
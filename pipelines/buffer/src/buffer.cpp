@@ -8,20 +8,18 @@ create_buffer_pipeline(rxcpp::observable<ServicePacket> trigger,
                        rxcpp::observable<ServicePacket> source,
                        const Logger& logger)
 {
-  auto combine = [](const ServicePacket& trigger_packet, const ServicePacket& source_packet) {
-    nlohmann::json payload{};
-    if (std::holds_alternative<nlohmann::json>(source_packet.get_payload( ))) {
-      payload["source"] = source_packet.template get_payload_as<nlohmann::json>( );
-    } else {
-      payload["source"] = source_packet.template get_payload_as<std::string>( );
-    }
-
-    if (std::holds_alternative<nlohmann::json>(trigger_packet.get_payload( ))) {
-      payload["trigger"] = trigger_packet.template get_payload_as<nlohmann::json>( );
+  auto embed = [](nlohmann::json& node, const ServicePacket& packet) {
+    if (const auto* json = std::get_if<nlohmann::json>(&packet.get_payload( ))) {
+      node = *json;
     } else {
-      payload["trigger"] = trigger_packet.template get_payload_as<std::string>( );
+      node = *packet.template get_payload_view<std::string>( );
     }
+  };
 
+  auto combine = [=](const ServicePacket& trigger_packet, const ServicePacket& source_packet) {
+    nlohmann::json payload{};
+    embed(payload["source"], source_packet);
+    embed(payload["trigger"], trigger_packet);
     return trigger_packet.with_payload({ std::move(payload) });
   };
 
@@ -5,9 +5,10 @@ namespace trawler {
 std::function<ServicePacket(ServicePacket)>
 create_emit_pipeline(const std::string& data, const Logger& logger)
 {
+  const auto payload = ServicePacket::make_payload(data);
   return [=](ServicePacket x) {
     logger.debug("Emitting " + data);
-    return x.with_payload({ data });
+    return x.with_shared_payload(payload);
   };
 }
 }
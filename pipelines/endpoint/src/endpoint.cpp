@@ -6,12 +6,17 @@ std::function<void(const ServicePacket&)>
 create_endpoint(const Logger& logger)
 {
   return [=](const ServicePacket& sp) {
-    auto payload = sp.template get_payload_as<std::string>( );
-    logger.debug("Payload is " + payload);
-    if (payload == "\n" || payload == "") {
+    if (sp.is_expired( )) {
+      logger.debug("Dropping a packet past its deadline");
+      sp.expire( );
+      return;
+    }
+    auto payload = sp.template get_payload_view<std::string>( );
+    logger.debug("Payload is " + *payload);
+    if (*payload == "\n" || payload->empty( )) {
       logger.debug("No payload to reply with");
     } else {
-      logger.debug("Replying with " + payload);
+      logger.debug("Replying with " + *payload);
       sp.reply(std::move(payload));
     }
   };
@@ -1,12 +1,71 @@
 #pragma once
+#include <chrono>
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <rxcpp/rx.hpp>
+#include <trawler/pipelines/http-client/http-connection-pool.hpp>
 #include <trawler/logging/logger.hpp>
+#include <trawler/services/service-context.hpp>
 #include <trawler/services/service-packet.hpp>
 
 namespace trawler {
-std::function<ServicePacket(ServicePacket)>
-create_http_client_pipeline(const Logger& logger = { "http-client" });
 
-std::function<ServicePacket(ServicePacket)>
-create_http_client_ssl_pipeline(const Logger& logger = { "http-client" });
+enum class EHttpStreaming
+{
+  NONE,
+  NDJSON,
+  JSON_ARRAY
+};
+
+struct http_client_options_t
+{
+  // Use https
+  bool ssl = false;
+
+  // Requests beyond this many are queued until an earlier one completes
+  std::size_t max_in_flight = 64;
+
+  // Identical requests in flight are sent upstream once and share the response
+  bool coalesce = true;
+
+  // Bytes of responses kept for GET requests according to their Cache-Control
+  // headers, 0 disables the cache
+  std::size_t cache_bytes = 0;
+
+  // Idempotent requests failing with a connection error, 502, 503 or 504 are
+  // retried this many times, backing off exponentially from retry_backoff
+  std::size_t retries = 0;
+  std::chrono::milliseconds retry_backoff{ 100 };
+
+  // Idempotent requests not answered within this percentile (0-100) of recent
+  // response times are sent once more and the first answer wins, 0 disables
+  // hedging. hedge_delay is used until enough response times are known
+  double hedge_percentile = 0;
+  std::chrono::milliseconds hedge_delay{ 100 };
+
+  // Responses with a larger body are dropped, 0 means no limit. When streaming
+  // the limit applies to each element instead
+  std::size_t max_body_bytes = 8 * 1024 * 1024;
+
+  // Emit a packet per NDJSON line or JSON array element of the body as it
+  // arrives. Streamed requests are never cached, coalesced, retried or hedged
+  EHttpStreaming streaming = EHttpStreaming::NONE;
+
+  // Keep-alive connections are reused through the pool, if there is one
+  std::shared_ptr<HttpConnectionPool> pool = nullptr;
+};
+
+/*******************************************************************************
+ * create_http_client_pipeline
+ *
+ * Sends the request described by each packet and emits the response as
+ * { "headers": { ... }, "body": ... }, or one such packet per element of the
+ * body when streaming. Requests are made asynchronously on the session context
+ * of `context`, so many of them may be in flight at once.
+ ******************************************************************************/
+std::function<rxcpp::observable<ServicePacket>(const ServicePacket&)>
+create_http_client_pipeline(const std::shared_ptr<ServiceContext>& context,
+                            const http_client_options_t& options = { },
+                            const Logger& logger = { "http-client" });
 }
@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace trawler {
+
+class HttpConnection;
+
+/*******************************************************************************
+ * HttpConnectionPool
+ *
+ * Keeps idle HTTP/1.1 keep-alive connections per (host, port, ssl), so that
+ * repeated requests to the same upstream skip connecting and handshaking. One
+ * pool is meant to be shared by all http-client pipelines of a configuration.
+ *
+ * At most `max_idle_per_host` connections are kept per upstream, and those
+ * idle for longer than `idle_timeout` are closed.
+ ******************************************************************************/
+class HttpConnectionPool
+{
+public:
+  using clock_t = std::chrono::steady_clock;
+
+  struct key_t
+  {
+    std::string host;
+    std::string port;
+    bool ssl;
+
+    bool operator<(const key_t& other) const
+    {
+      return std::tie(host, port, ssl) < std::tie(other.host, other.port, other.ssl);
+    }
+  };
+
+private:
+  struct idle_t
+  {
+    std::shared_ptr<HttpConnection> connection;
+    clock_t::time_point since;
+  };
+
+  mutable std::mutex mutex;
+  std::map<key_t, std::vector<idle_t>> idle;
+  std::size_t max_idle_per_host;
+  clock_t::duration idle_timeout;
+
+  std::vector<std::shared_ptr<HttpConnection>> evict_expired(clock_t::time_point now);
+
+public:
+  explicit HttpConnectionPool(std::size_t max_idle_per_host = 8,
+                              clock_t::duration idle_timeout = std::chrono::seconds{ 30 });
+
+  HttpConnectionPool(const HttpConnectionPool&) = delete;
+  HttpConnectionPool(HttpConnectionPool&&) = delete;
+  HttpConnectionPool& operator=(const HttpConnectionPool&) = delete;
+  HttpConnectionPool& operator=(HttpConnectionPool&&) = delete;
+  ~HttpConnectionPool( );
+
+  // Returns the most recently used idle connection to the upstream, or nullptr
+  std::shared_ptr<HttpConnection> checkout(const key_t& key);
+
+  // Hands a connection with no request in progress back to the pool
+  void release(const key_t& key, std::shared_ptr<HttpConnection> connection);
+
+  std::size_t idle_count( ) const;
+};
+}
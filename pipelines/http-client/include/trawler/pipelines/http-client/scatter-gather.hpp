@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <rxcpp/rx.hpp>
+#include <trawler/logging/logger.hpp>
+#include <trawler/pipelines/http-client/http-client.hpp>
+#include <trawler/services/service-context.hpp>
+#include <trawler/services/service-packet.hpp>
+
+namespace trawler {
+
+struct http_scatter_gather_options_t
+{
+  // The client making the calls, every call gets a single response so streaming is ignored
+  http_client_options_t client = { };
+
+  // Calls not answered this long after they were issued are reported as timed out, 0 waits for all of them.
+  // A packet with an earlier deadline stops waiting at its deadline instead
+  std::chrono::milliseconds timeout{ 5000 };
+};
+
+/*******************************************************************************
+ * create_http_scatter_gather_pipeline
+ *
+ * Takes packets holding a list of requests, either as the payload itself or
+ * under "requests", each described the way the http-client pipeline expects.
+ * The requests are issued concurrently and, once all of them are answered,
+ * failed or timed out, a single packet is emitted:
+ *
+ *   { "responses": [ { "headers": { ... }, "body": ... }, null, ... ],
+ *     "errors": [ { "index": 1, "error": "timed out" } ] }
+ *
+ * Responses are in the order of the requests. A call that failed or timed out
+ * is null in "responses" and listed in "errors", the others are still emitted.
+ ******************************************************************************/
+std::function<rxcpp::observable<ServicePacket>(const ServicePacket&)>
+create_http_scatter_gather_pipeline(const std::shared_ptr<ServiceContext>& context,
+                                    const http_scatter_gather_options_t& options = { },
+                                    const Logger& logger = { "http-scatter-gather" });
+}
@@ -1,85 +1,617 @@
-#include "get-string.hpp"
-#include <boost/algorithm/string/predicate.hpp>
-#include <boost/asio/connect.hpp>
-#include <boost/asio/ip/tcp.hpp>
-#include <boost/beast/core.hpp>
-#include <boost/beast/core/buffers_to_string.hpp>
-#include <boost/beast/http.hpp>
-#include <boost/beast/version.hpp>
-#include <cstdlib>
-#include <iostream>
+#include "http-connection.hpp"
+#include "http-request.hpp"
+#include "in-flight-limiter.hpp"
+#include "json-stream-splitter.hpp"
+#include "latency-tracker.hpp"
+#include "request-coalescer.hpp"
+#include "response-cache.hpp"
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <random>
 #include <trawler/pipelines/http-client/http-client.hpp>
 
 namespace trawler {
 
-using tcp = boost::asio::ip::tcp;    // from <boost/asio/ip/tcp.hpp>
-namespace http = boost::beast::http; // from <boost/beast/http.hpp>
+using tcp = boost::asio::ip::tcp;
+using error_t = boost::system::error_code;
 
-std::function<ServicePacket(ServicePacket)>
-create_http_client_pipeline(const Logger& logger)
+namespace {
+
+/*******************************************************************************
+ * make_http_connection
+ ******************************************************************************/
+std::shared_ptr<HttpConnection>
+make_http_connection(boost::asio::io_context& context, const std::shared_ptr<ClientTlsContext>& tls)
+{
+  if (tls) {
+    return std::make_shared<ssl_http_connection_t>(tls, context, tls->get( ));
+  }
+  return std::make_shared<tcp_http_connection_t>(nullptr, context);
+}
+
+/*******************************************************************************
+ * is_stale_connection
+ *
+ * The errors seen when reusing a connection the server has already closed.
+ ******************************************************************************/
+bool
+is_stale_connection(error_t ec)
+{
+  return ec == boost::beast::http::error::end_of_stream || ec == boost::asio::error::eof ||
+         ec == boost::asio::error::connection_reset || ec == boost::asio::error::broken_pipe ||
+         ec == boost::asio::ssl::error::stream_truncated;
+}
+
+/*******************************************************************************
+ * make_http_transport
+ *
+ * Returns a function getting a connection to an upstream, running a transfer
+ * (a request and its response) on it, then handing the error, if any, to a
+ * callback. Everything runs asynchronously on the session context.
+ *
+ * With a pool, an idle keep-alive connection to the upstream is reused when
+ * there is one, and the connection is handed back afterwards if both ends
+ * agree to keep it alive. A pooled connection found dead is replaced by a
+ * fresh one transparently.
+ ******************************************************************************/
+auto
+make_http_transport(const std::shared_ptr<ServiceContext>& context,
+                    const std::shared_ptr<ClientTlsContext>& tls,
+                    const std::shared_ptr<HttpConnectionPool>& pool,
+                    const Logger& logger)
+{
+  using connection_tp = std::shared_ptr<HttpConnection>;
+  using on_transferred_t = std::function<void(error_t, bool keep_alive)>;
+  using transfer_t = std::function<void(const connection_tp&, on_transferred_t)>;
+  using on_done_t = std::function<void(error_t)>;
+
+  return [=](const http_endpoint_t& endpoint, transfer_t transfer, on_done_t on_done) {
+    const auto key = HttpConnectionPool::key_t{ endpoint.host, endpoint.port, tls != nullptr };
+
+    auto send = [=](connection_tp connection, bool reused, auto on_stale) {
+      auto on_transferred = [=](error_t ec, bool keep_alive) {
+        if (ec && reused && is_stale_connection(ec)) {
+          logger.debug("Pooled connection was closed by the server, reconnecting");
+          connection->close( );
+          on_stale( );
+          return;
+        }
+
+        if (!ec && pool && keep_alive) {
+          pool->release(key, connection);
+        } else {
+          connection->close( );
+        }
+        on_done(ec);
+      };
+      transfer(connection, std::move(on_transferred));
+    };
+
+    auto connect = [=]( ) {
+      auto connection = make_http_connection(context->get_session_context( ), tls);
+
+      auto on_connect = [=](error_t ec) {
+        if (ec) {
+          logger.debug("Connection failed: " + ec.message( ));
+          on_done(ec);
+          return;
+        }
+        send(connection, false, [] {});
+      };
+
+      auto on_resolve = [connection, endpoint, on_connect, on_done, logger](error_t ec,
+                                                                           tcp::resolver::results_type results) {
+        if (ec) {
+          logger.debug("Address resolution failed: " + ec.message( ));
+          on_done(ec);
+          return;
+        }
+        connection->async_connect(results, endpoint.host, on_connect);
+      };
+
+      context->get_resolver_cache( ).async_resolve(endpoint.host, endpoint.port, std::move(on_resolve));
+    };
+
+    if (auto connection = pool ? pool->checkout(key) : nullptr) {
+      send(std::move(connection), true, connect);
+    } else {
+      connect( );
+    }
+  };
+}
+
+/*******************************************************************************
+ * make_http_exchange
+ *
+ * Returns a function sending a single request, then handing the whole response
+ * (or the error) to a callback.
+ ******************************************************************************/
+template<typename Transport>
+auto
+make_http_exchange(Transport transport, std::size_t body_limit)
+{
+  using on_done_t = std::function<void(error_t, std::shared_ptr<http_response_t>)>;
+  using on_transferred_t = std::function<void(error_t, bool keep_alive)>;
+
+  return [=](const http_endpoint_t& endpoint, std::shared_ptr<const http_request_t> request, on_done_t on_done) {
+    auto response = std::make_shared<std::shared_ptr<http_response_t>>( );
+
+    auto transfer = [=](const std::shared_ptr<HttpConnection>& connection, on_transferred_t on_transferred) {
+      connection->async_request(request, body_limit, [=](error_t ec, std::shared_ptr<http_response_t> result) {
+        *response = std::move(result);
+        on_transferred(ec, !ec && request->keep_alive( ) && (*response)->keep_alive( ));
+      });
+    };
+
+    transport(endpoint, std::move(transfer), [=](error_t ec) { on_done(ec, ec ? nullptr : std::move(*response)); });
+  };
+}
+
+/*******************************************************************************
+ * make_http_stream_exchange
+ *
+ * Returns a function sending a single request, then handing each part of the
+ * response body to a callback as it arrives.
+ ******************************************************************************/
+template<typename Transport>
+auto
+make_http_stream_exchange(Transport transport)
+{
+  using on_done_t = std::function<void(error_t)>;
+  using on_transferred_t = std::function<void(error_t, bool keep_alive)>;
+
+  return [=](const http_endpoint_t& endpoint,
+             std::shared_ptr<const http_request_t> request,
+             HttpConnection::on_body_t on_body,
+             on_done_t on_done) {
+    auto transfer = [=](const std::shared_ptr<HttpConnection>& connection, on_transferred_t on_transferred) {
+      connection->async_request_stream(request, on_body, [=](error_t ec, bool keep_alive) {
+        on_transferred(ec, keep_alive && request->keep_alive( ));
+      });
+    };
+
+    transport(endpoint, std::move(transfer), std::move(on_done));
+  };
+}
+
+/*******************************************************************************
+ * is_idempotent
+ ******************************************************************************/
+bool
+is_idempotent(const http_request_t& request)
+{
+  return request.method( ) == boost::beast::http::verb::get || request.method( ) == boost::beast::http::verb::head;
+}
+
+/*******************************************************************************
+ * is_retryable
+ *
+ * Whether an attempt failed in a way another attempt might not.
+ ******************************************************************************/
+bool
+is_retryable(error_t ec, const std::shared_ptr<http_response_t>& response)
+{
+  namespace http = boost::beast::http;
+
+  if (ec) {
+    return ec != http::error::body_limit;
+  }
+  const auto status = response->result( );
+  return status == http::status::bad_gateway || status == http::status::service_unavailable ||
+         status == http::status::gateway_timeout;
+}
+
+/*******************************************************************************
+ * make_backoff
+ *
+ * Half of base * 2^retry plus a random part of the other half, so retries from
+ * many requests failing at once are spread out.
+ ******************************************************************************/
+std::chrono::milliseconds
+make_backoff(std::chrono::milliseconds base, std::size_t retry)
+{
+  thread_local auto generator = std::mt19937{ std::random_device{ }( ) };
+
+  const auto ceiling = base.count( ) << std::min<std::size_t>(retry, 16);
+  auto jitter = std::uniform_int_distribution<long long>{ 0, ceiling / 2 };
+  return std::chrono::milliseconds{ ceiling - ceiling / 2 + jitter(generator) };
+}
+
+/*******************************************************************************
+ * make_resilient_exchange
+ *
+ * Wraps an exchange with retries and hedging for idempotent requests.
+ *
+ * A failed attempt (see is_retryable) is retried up to options.retries times
+ * after a jittered, exponentially growing backoff. With hedging, a request not
+ * answered within options.hedge_percentile of recent response times is sent a
+ * second time and the first answer wins; the loser is left to finish on its
+ * own so its connection can still be pooled.
+ ******************************************************************************/
+template<typename Exchange>
+auto
+make_resilient_exchange(const std::shared_ptr<ServiceContext>& context,
+                        Exchange exchange,
+                        const http_client_options_t& options,
+                        const Logger& logger)
+{
+  using on_done_t = std::function<void(error_t, std::shared_ptr<http_response_t>)>;
+  using clock_t = std::chrono::steady_clock;
+
+  // The attempt function refers back to the attempts, the cycle is broken once done
+  struct attempts_t
+  {
+    std::mutex mutex;
+    boost::asio::steady_timer hedge_timer;
+    boost::asio::steady_timer retry_timer;
+    std::function<void( )> attempt;
+    std::size_t retries = 0;
+    std::size_t outstanding = 0;
+    bool done = false;
+
+    explicit attempts_t(boost::asio::io_context& context)
+      : hedge_timer{ context }
+      , retry_timer{ context }
+    {}
+
+    void run( )
+    {
+      auto next = std::function<void( )>{ };
+      {
+        std::lock_guard<std::mutex> lock{ mutex };
+        next = attempt;
+      }
+      if (next) {
+        next( );
+      }
+    }
+  };
+
+  auto latencies = std::make_shared<LatencyTracker>( );
+  const auto retries = options.retries;
+  const auto retry_backoff = options.retry_backoff;
+  const auto hedge_percentile = options.hedge_percentile;
+  const auto hedge_delay = options.hedge_delay;
+
+  return [=](const http_endpoint_t& endpoint, std::shared_ptr<const http_request_t> request, on_done_t on_done) {
+    if (!is_idempotent(*request) || (retries == 0 && hedge_percentile <= 0)) {
+      exchange(endpoint, std::move(request), std::move(on_done));
+      return;
+    }
+
+    auto attempts = std::make_shared<attempts_t>(context->get_session_context( ));
+
+    // The first attempt to succeed (or the last one to fail) completes the request
+    auto on_attempt = [=](clock_t::time_point started, error_t ec, std::shared_ptr<http_response_t> response) {
+      {
+        std::lock_guard<std::mutex> lock{ attempts->mutex };
+        --attempts->outstanding;
+        if (attempts->done) {
+          return;
+        }
+
+        if (is_retryable(ec, response)) {
+          if (attempts->outstanding > 0) {
+            return;
+          }
+          if (attempts->retries < retries) {
+            const auto backoff = make_backoff(retry_backoff, attempts->retries++);
+            logger.debug("Retrying request in " + std::to_string(backoff.count( )) + " ms");
+            attempts->retry_timer.expires_after(backoff);
+            attempts->retry_timer.async_wait([attempts](error_t ec) {
+              if (!ec) {
+                attempts->run( );
+              }
+            });
+            return;
+          }
+        } else {
+          latencies->record(clock_t::now( ) - started);
+        }
+
+        attempts->done = true;
+        attempts->attempt = nullptr;
+        attempts->hedge_timer.cancel( );
+      }
+      on_done(ec, std::move(response));
+    };
+
+    attempts->attempt = [=]( ) {
+      {
+        std::lock_guard<std::mutex> lock{ attempts->mutex };
+        ++attempts->outstanding;
+      }
+      const auto started = clock_t::now( );
+      exchange(endpoint, request, [=](error_t ec, std::shared_ptr<http_response_t> response) {
+        on_attempt(started, ec, std::move(response));
+      });
+    };
+
+    if (hedge_percentile > 0) {
+      const auto delay = latencies->percentile(hedge_percentile).value_or(hedge_delay);
+      attempts->hedge_timer.expires_after(delay);
+      attempts->hedge_timer.async_wait([attempts, logger](error_t ec) {
+        {
+          std::lock_guard<std::mutex> lock{ attempts->mutex };
+          if (ec || attempts->done || attempts->outstanding == 0) {
+            return;
+          }
+        }
+        logger.debug("Request is slow, hedging");
+        attempts->run( );
+      });
+    }
+
+    attempts->run( );
+  };
+}
+
+/*******************************************************************************
+ * make_response_payload
+ *
+ * Returns the payload emitted for a response, or nullptr if it can't be
+ * converted.
+ ******************************************************************************/
+ServicePacket::shared_payload_t
+make_response_payload(const http_response_t& response, const Logger& logger)
+{
+  try {
+    return ServicePacket::make_payload(make_http_response_json(response));
+  } catch (const std::exception& e) {
+    logger.critical(std::string{ "Invalid response: " } + e.what( ));
+    return nullptr;
+  }
+}
+}
+
+std::function<rxcpp::observable<ServicePacket>(const ServicePacket&)>
+create_http_client_pipeline(const std::shared_ptr<ServiceContext>& context,
+                            const http_client_options_t& options,
+                            const Logger& logger)
 {
-  return [=](const ServicePacket& service_packet) {
-    const auto payload = service_packet.get_payload_as<nlohmann::json>( );
+  using payload_tp = ServicePacket::shared_payload_t;
+  using on_fetched_t = std::function<void(const payload_tp&)>;
+  using on_response_t = std::function<void(std::shared_ptr<http_response_t>)>;
+  using abandoned_t = std::function<bool( )>;
 
-    const auto host = get_string(payload, "host");
-    const auto port = get_string(payload, "port");
-    const auto target = get_string(payload, "target");
-    const auto version = get_string(payload, "version") == "1.0" ? 10 : 11;
+  const auto tls = options.ssl ? get_client_tls_context( ) : nullptr;
 
-    // The io_context is required for all I/O
-    boost::asio::io_context ioc;
+  auto limiter = std::make_shared<InFlightLimiter>(options.max_in_flight);
+  auto coalescer = options.coalesce ? std::make_shared<RequestCoalescer<payload_tp>>( ) : nullptr;
+  auto cache = options.cache_bytes > 0 ? std::make_shared<ResponseCache>(options.cache_bytes) : nullptr;
+  auto service_strand = make_service_strand(context);
+  auto transport = make_http_transport(context, tls, options.pool, logger);
+  auto exchange =
+    make_resilient_exchange(context, make_http_exchange(transport, options.max_body_bytes), options, logger);
+  auto stream_exchange = make_http_stream_exchange(transport);
+  const auto streaming = options.streaming;
+  const auto max_body_bytes = options.max_body_bytes;
 
-    // These objects perform our I/O
-    tcp::resolver resolver{ ioc };
-    tcp::socket socket{ ioc };
+  // Performs a request once a slot is free, the response is nullptr if it failed or was abandoned while queued
+  auto fetch = [=](const http_endpoint_t& endpoint,
+                   std::shared_ptr<const http_request_t> request,
+                   const abandoned_t& abandoned,
+                   on_response_t on_response) {
+    limiter->submit([=] {
+      if (abandoned && abandoned( )) {
+        limiter->release( );
+        logger.debug("Dropping abandoned request");
+        on_response(nullptr);
+        return;
+      }
+
+      auto on_done = [=](error_t ec, std::shared_ptr<http_response_t> response) {
+        limiter->release( );
+
+        if (ec) {
+          logger.critical("Request failed: " + ec.message( ));
+          on_response(nullptr);
+          return;
+        }
+        on_response(std::move(response));
+      };
+      exchange(endpoint, request, std::move(on_done));
+    });
+  };
 
-    // Look up the domain name
-    auto const results = resolver.resolve(host, port);
+  // Streams a request once a slot is free, handing over a payload per element of the body as soon as it is complete
+  auto stream = [=](const http_endpoint_t& endpoint,
+                    std::shared_ptr<const http_request_t> request,
+                    const abandoned_t& abandoned,
+                    on_fetched_t on_element,
+                    std::function<void( )> on_streamed) {
+    limiter->submit([=] {
+      if (abandoned && abandoned( )) {
+        limiter->release( );
+        logger.debug("Dropping abandoned request");
+        on_streamed( );
+        return;
+      }
 
-    // Make the connection on the IP address we get from a lookup
-    boost::asio::connect(socket, results.begin( ), results.end( ));
+      auto splitter = std::make_shared<JsonStreamSplitter>(streaming, max_body_bytes);
+      auto headers = std::make_shared<nlohmann::json>( );
 
-    // Set up an HTTP GET request message
-    http::request<http::string_body> req{ http::verb::get, target.c_str( ), version };
-    req.set(http::field::host, host);
-    req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+      auto sink = [on_element, headers](std::string_view element) {
+        auto json = nlohmann::json{ { "headers", *headers } };
+        json["body"] = nlohmann::json::parse(begin(element), end(element));
+        on_element(ServicePacket::make_payload(std::move(json)));
+      };
+
+      auto on_body = [=](const http_response_header_t& header, std::string_view chunk) {
+        try {
+          if (headers->is_null( )) {
+            *headers = make_http_response_headers_json(header);
+          }
+          splitter->feed(chunk, sink);
+          return true;
+        } catch (const std::exception& e) {
+          logger.critical(std::string{ "Invalid response: " } + e.what( ));
+          return false;
+        }
+      };
+
+      auto on_done = [=](error_t ec) {
+        limiter->release( );
+
+        if (!ec) {
+          try {
+            splitter->finish(sink);
+          } catch (const std::exception& e) {
+            logger.critical(std::string{ "Invalid response: " } + e.what( ));
+          }
+        } else if (ec != boost::asio::error::operation_aborted) {
+          // Aborted streams were logged by on_body
+          logger.critical("Request failed: " + ec.message( ));
+        }
+        on_streamed( );
+      };
+
+      stream_exchange(endpoint, request, std::move(on_body), std::move(on_done));
+    });
+  };
 
-    // Send the HTTP request to the remote host
-    http::write(socket, req);
+  // Fetches the payload for a request, revalidating the cached response if it has validators
+  auto fetch_payload = [=](const http_endpoint_t& endpoint,
+                           std::shared_ptr<const http_request_t> request,
+                           const std::string& key,
+                           const ResponseCache::lookup_t& cached,
+                           const abandoned_t& abandoned,
+                           on_fetched_t on_fetched) {
+    const auto revalidate = cached.payload && (!cached.etag.empty( ) || !cached.last_modified.empty( ));
+    auto upstream_request = revalidate ? make_conditional_request(*request, cached) : request;
 
-    // This buffer is used for reading and must be persisted
-    boost::beast::flat_buffer buffer;
+    fetch(endpoint, upstream_request, abandoned, [=](std::shared_ptr<http_response_t> response) {
+      if (!response) {
+        on_fetched(nullptr);
+        return;
+      }
 
-    // Declare a container to hold the response
-    http::response<http::dynamic_body> res;
+      if (revalidate && response->result( ) == boost::beast::http::status::not_modified) {
+        logger.debug("Cached response revalidated");
+        cache->refresh(key, *response);
+        on_fetched(cached.payload);
+        return;
+      }
 
-    // Receive the HTTP response
-    http::read(socket, buffer, res);
+      auto payload = make_response_payload(*response, logger);
+      if (payload && cache && request->method( ) == boost::beast::http::verb::get) {
+        cache->store(key, *response, payload);
+      }
+      on_fetched(payload);
+    });
+  };
 
-    // Store the result
-    nlohmann::json json;
-    for (const auto& header : res.base( )) {
-      json["headers"][std::string{ header.name_string( ) }] = std::string{ header.value( ) };
+  // Identical requests already in flight share the response of the first one. A shared request is only abandoned
+  // once every packet waiting for it is abandoned
+  auto dispatch = [=](const http_endpoint_t& endpoint,
+                      std::shared_ptr<const http_request_t> request,
+                      const std::string& key,
+                      const ResponseCache::lookup_t& cached,
+                      abandoned_t abandoned,
+                      on_fetched_t on_fetched) {
+    if (!coalescer) {
+      fetch_payload(endpoint, request, key, cached, abandoned, std::move(on_fetched));
+      return;
     }
-    if (boost::starts_with(res[http::field::content_type], "application/json")) {
-      json["body"] = nlohmann::json::parse(boost::beast::buffers_to_string(res.body( ).data( )));
+
+    if (coalescer->join(key, std::move(on_fetched), std::move(abandoned))) {
+      auto all_abandoned = [coalescer, key] { return coalescer->abandoned(key); };
+      fetch_payload(endpoint, request, key, cached, all_abandoned, [coalescer, key](const payload_tp& result) {
+        coalescer->complete(key, result);
+      });
     } else {
-      json["body"] = boost::beast::buffers_to_string(res.body( ).data( ));
+      logger.debug("Joining identical request in flight");
     }
+  };
+
+  return [=](const ServicePacket& packet) {
+    // Handlers hold a copy of the strand only, the shared one keeps the context alive
+    return rxcpp::observable<>::create<ServicePacket>([=, strand = *service_strand](auto subscriber) {
+      // Results are delivered on the service strand, no matter which session thread completed the request
+      // A packet whose deadline passed in the meantime is expired instead, its requester has given up on it
+      auto on_result = [=](const payload_tp& result) {
+        boost::asio::post(strand, [=] {
+          if (packet.is_expired( )) {
+            packet.expire( );
+          } else if (result) {
+            subscriber.on_next(packet.with_shared_payload(result));
+          }
+          subscriber.on_completed( );
+        });
+      };
+
+      if (packet.is_expired( )) {
+        logger.debug("Dropping packet past its deadline");
+        on_result(nullptr);
+        return;
+      }
+
+      // A failed request is logged and dropped rather than terminating the whole pipeline
+      auto request = std::pair<http_endpoint_t, std::shared_ptr<const http_request_t>>{ };
+      try {
+        const auto payload = packet.get_payload_view<nlohmann::json>( );
+        if (logger.should_log(Logger::ELogLevel::DEBUG)) {
+          logger.debug("Got " + *packet.get_payload_view<std::string>( ));
+        }
+        request = make_http_request(*payload);
+      } catch (const std::exception& e) {
+        logger.critical(std::string{ "Invalid request: " } + e.what( ));
+        on_result(nullptr);
+        return;
+      }
+
+      const auto& [endpoint, http_request] = request;
+
+      // A request is given up on while queued once its packet is past its deadline or nobody subscribes to it anymore
+      auto abandoned = [deadline = packet.get_deadline( ), subscriber] {
+        return (deadline && deadline->has_passed( )) || !subscriber.is_subscribed( );
+      };
+
+      if (streaming != EHttpStreaming::NONE) {
+        auto on_element = [=](const payload_tp& element) {
+          boost::asio::post(strand, [=] { subscriber.on_next(packet.with_shared_payload(element)); });
+        };
+        stream(endpoint, http_request, abandoned, on_element, [=] {
+          boost::asio::post(strand, [=] {
+            if (packet.is_expired( )) {
+              packet.expire( );
+            }
+            subscriber.on_completed( );
+          });
+        });
+        return;
+      }
+
+      const auto key = make_http_request_key(endpoint, *http_request, tls != nullptr);
+
+      if (!cache || http_request->method( ) != boost::beast::http::verb::get) {
+        dispatch(endpoint, http_request, key, { }, abandoned, on_result);
+        return;
+      }
 
-    // Gracefully close the socket
-    boost::system::error_code ec;
-    socket.shutdown(tcp::socket::shutdown_both, ec);
+      const auto cached = cache->lookup(key);
+      switch (cached.freshness) {
+        case ResponseCache::EFreshness::FRESH:
+          logger.debug("Serving cached response");
+          on_result(cached.payload);
+          return;
 
-    // not_connected happens sometimes
-    // so don't bother reporting it.
-    //
-    if (ec && ec != boost::system::errc::not_connected)
-      throw boost::system::system_error{ ec };
+        case ResponseCache::EFreshness::STALE_WHILE_REVALIDATE:
+          // A failed background revalidation isn't retried until the response goes stale for good
+          logger.debug("Serving stale cached response while revalidating");
+          on_result(cached.payload);
+          if (cache->start_revalidation(key)) {
+            dispatch(endpoint, http_request, key, cached, nullptr, [](const payload_tp&) {});
+          }
+          return;
 
-    // If we get here then the connection is closed gracefully
-    return service_packet.with_payload(std::move(json));
+        default:
+          dispatch(endpoint, http_request, key, cached, abandoned, on_result);
+          return;
+      }
+    });
   };
 }
 }
@@ -0,0 +1,99 @@
+#include "http-connection.hpp"
+#include <trawler/pipelines/http-client/http-connection-pool.hpp>
+
+namespace trawler {
+
+HttpConnectionPool::HttpConnectionPool(std::size_t max_idle_per_host, clock_t::duration idle_timeout)
+  : max_idle_per_host{ max_idle_per_host }
+  , idle_timeout{ idle_timeout }
+{}
+
+HttpConnectionPool::~HttpConnectionPool( )
+{
+  for (auto& [key, connections] : idle) {
+    for (auto& entry : connections) {
+      entry.connection->close( );
+    }
+  }
+}
+
+std::vector<std::shared_ptr<HttpConnection>>
+HttpConnectionPool::evict_expired(clock_t::time_point now)
+{
+  auto expired = std::vector<std::shared_ptr<HttpConnection>>{ };
+
+  for (auto it = begin(idle); it != end(idle);) {
+    auto& connections = it->second;
+
+    // Connections are pushed in the order they were released, so the expired ones are at the front
+    auto first_alive = begin(connections);
+    while (first_alive != end(connections) && now - first_alive->since > idle_timeout) {
+      expired.push_back(std::move(first_alive->connection));
+      ++first_alive;
+    }
+    connections.erase(begin(connections), first_alive);
+
+    it = connections.empty( ) ? idle.erase(it) : std::next(it);
+  }
+
+  return expired;
+}
+
+std::shared_ptr<HttpConnection>
+HttpConnectionPool::checkout(const key_t& key)
+{
+  auto expired = std::vector<std::shared_ptr<HttpConnection>>{ };
+  auto connection = std::shared_ptr<HttpConnection>{ };
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    expired = evict_expired(clock_t::now( ));
+
+    const auto found = idle.find(key);
+    if (found != end(idle)) {
+      connection = std::move(found->second.back( ).connection);
+      found->second.pop_back( );
+      if (found->second.empty( )) {
+        idle.erase(found);
+      }
+    }
+  }
+
+  for (auto& stale : expired) {
+    stale->close( );
+  }
+  return connection;
+}
+
+void
+HttpConnectionPool::release(const key_t& key, std::shared_ptr<HttpConnection> connection)
+{
+  auto expired = std::vector<std::shared_ptr<HttpConnection>>{ };
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    const auto now = clock_t::now( );
+    expired = evict_expired(now);
+
+    auto& connections = idle[key];
+    if (connections.size( ) < max_idle_per_host) {
+      connections.push_back({ std::move(connection), now });
+    } else {
+      expired.push_back(std::move(connection));
+    }
+  }
+
+  for (auto& stale : expired) {
+    stale->close( );
+  }
+}
+
+std::size_t
+HttpConnectionPool::idle_count( ) const
+{
+  std::lock_guard<std::mutex> lock{ mutex };
+  auto count = std::size_t{ 0 };
+  for (const auto& [key, connections] : idle) {
+    count += connections.size( );
+  }
+  return count;
+}
+}
@@ -0,0 +1,234 @@
+#pragma once
+#include "http-request.hpp"
+#include <array>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <trawler/services/tcp-common/client-tls-context.hpp>
+#include <type_traits>
+
+namespace trawler {
+
+/*******************************************************************************
+ * HttpConnection
+ *
+ * A connection to an upstream server, able to carry one request at a time.
+ *
+ * A response is either read whole, with a body of at most body_limit bytes (0
+ * for no limit), or streamed: every part of the body is handed to on_body as
+ * it arrives, until on_body returns false.
+ ******************************************************************************/
+class HttpConnection
+{
+public:
+  using error_t = boost::system::error_code;
+  using results_t = boost::asio::ip::tcp::resolver::results_type;
+  using on_connect_t = std::function<void(error_t)>;
+  using on_response_t = std::function<void(error_t, std::shared_ptr<http_response_t>)>;
+  using on_body_t = std::function<bool(const http_response_header_t&, std::string_view)>;
+  using on_streamed_t = std::function<void(error_t, bool keep_alive)>;
+
+  HttpConnection( ) = default;
+  HttpConnection(const HttpConnection&) = delete;
+  HttpConnection(HttpConnection&&) = delete;
+  HttpConnection& operator=(const HttpConnection&) = delete;
+  HttpConnection& operator=(HttpConnection&&) = delete;
+  virtual ~HttpConnection( ) = default;
+
+  virtual void async_connect(const results_t& results, const std::string& host, on_connect_t on_connect) = 0;
+  virtual void async_request(std::shared_ptr<const http_request_t> request,
+                             std::size_t body_limit,
+                             on_response_t on_response) = 0;
+  virtual void async_request_stream(std::shared_ptr<const http_request_t> request,
+                                    on_body_t on_body,
+                                    on_streamed_t on_streamed) = 0;
+  virtual void close( ) = 0;
+};
+
+/*******************************************************************************
+ * BasicHttpConnection
+ *
+ * An HttpConnection over a plain tcp socket or an ssl stream. Ssl streams are
+ * created from the shared ClientTlsContext, which lets them resume sessions.
+ ******************************************************************************/
+template<typename Stream>
+class BasicHttpConnection
+  : public HttpConnection
+  , public std::enable_shared_from_this<BasicHttpConnection<Stream>>
+{
+  static constexpr auto is_ssl = !std::is_same_v<Stream, boost::asio::ip::tcp::socket>;
+
+  // Rather than boost::none, which some Beast versions compare wrongly against a Content-Length
+  static constexpr auto no_body_limit = std::numeric_limits<std::uint64_t>::max( );
+
+  std::shared_ptr<ClientTlsContext> tls;
+  Stream stream;
+  boost::beast::flat_buffer buffer;
+
+  auto& socket( )
+  {
+    if constexpr (is_ssl) {
+      return stream.next_layer( );
+    } else {
+      return stream;
+    }
+  }
+
+public:
+  template<typename... Args>
+  explicit BasicHttpConnection(std::shared_ptr<ClientTlsContext> tls, Args&&... args)
+    : tls{ std::move(tls) }
+    , stream{ std::forward<Args>(args)... }
+  {}
+
+  void async_connect(const results_t& results, const std::string& host, on_connect_t on_connect) override
+  {
+    auto self = this->shared_from_this( );
+
+    if constexpr (is_ssl) {
+      // Set SNI Hostname (many hosts need this to handshake successfully) and offer a cached session
+      if (!tls->prepare(stream.native_handle( ), host)) {
+        on_connect(error_t{ static_cast<int>(::ERR_get_error( )), boost::asio::error::get_ssl_category( ) });
+        return;
+      }
+    }
+
+    auto on_tcp_connect = [self, on_connect](error_t ec, auto /*endpoint*/) {
+      if constexpr (is_ssl) {
+        if (!ec) {
+          self->stream.async_handshake(boost::asio::ssl::stream_base::client, on_connect);
+          return;
+        }
+      }
+      on_connect(ec);
+    };
+
+    boost::asio::async_connect(socket( ), results, std::move(on_tcp_connect));
+  }
+
+  void async_request(std::shared_ptr<const http_request_t> request,
+                     std::size_t body_limit,
+                     on_response_t on_response) override
+  {
+    namespace http = boost::beast::http;
+
+    auto self = this->shared_from_this( );
+    auto parser = std::make_shared<http::response_parser<http::string_body>>( );
+    parser->body_limit(body_limit > 0 ? body_limit : no_body_limit);
+
+    auto on_read = [self, parser, on_response](error_t ec, std::size_t) {
+      on_response(ec, std::make_shared<http_response_t>(parser->release( )));
+    };
+
+    // The header is read on its own, a whole message read doesn't stop on a Content-Length beyond the limit
+    auto on_header = [self, parser, on_response, on_read](error_t ec, std::size_t) {
+      if (ec) {
+        on_response(ec, nullptr);
+        return;
+      }
+      http::async_read(self->stream, self->buffer, *parser, on_read);
+    };
+
+    auto on_write = [self, request, parser, on_response, on_header](error_t ec, std::size_t) {
+      if (ec) {
+        on_response(ec, nullptr);
+        return;
+      }
+      http::async_read_header(self->stream, self->buffer, *parser, on_header);
+    };
+
+    http::async_write(stream, *request, std::move(on_write));
+  }
+
+  void async_request_stream(std::shared_ptr<const http_request_t> request,
+                            on_body_t on_body,
+                            on_streamed_t on_streamed) override
+  {
+    namespace http = boost::beast::http;
+
+    struct stream_t
+    {
+      http::response_parser<http::buffer_body> parser;
+      std::array<char, 16 * 1024> chunk;
+      std::function<void( )> read_next;
+    };
+
+    auto self = this->shared_from_this( );
+    auto state = std::make_shared<stream_t>( );
+    state->parser.body_limit(no_body_limit);
+
+    // Reads the body one chunk at a time, the state refers to itself until the body is done
+    auto finish = [state, on_streamed](error_t ec) {
+      state->read_next = nullptr;
+      on_streamed(ec, !ec && state->parser.keep_alive( ));
+    };
+
+    state->read_next = [self, state = state.get( ), on_body, finish] {
+      auto& body = state->parser.get( ).body( );
+      body.data = state->chunk.data( );
+      body.size = state->chunk.size( );
+
+      auto on_read = [self, state, on_body, finish](error_t ec, std::size_t) {
+        if (ec == http::error::need_buffer) {
+          ec = { };
+        }
+        if (ec) {
+          // The response has started, whatever the cause it can't be retried on another connection
+          finish(http::error::partial_message);
+          return;
+        }
+
+        const auto size = state->chunk.size( ) - state->parser.get( ).body( ).size;
+        if (!on_body(state->parser.get( ).base( ), std::string_view{ state->chunk.data( ), size })) {
+          finish(boost::asio::error::operation_aborted);
+          return;
+        }
+
+        if (state->parser.is_done( )) {
+          finish({ });
+        } else {
+          state->read_next( );
+        }
+      };
+      http::async_read(self->stream, self->buffer, state->parser, std::move(on_read));
+    };
+
+    auto on_header = [self, state, finish](error_t ec, std::size_t) {
+      if (ec || state->parser.is_done( )) {
+        finish(ec);
+        return;
+      }
+      state->read_next( );
+    };
+
+    auto on_write = [self, request, state, on_header, finish](error_t ec, std::size_t) {
+      if (ec) {
+        finish(ec);
+        return;
+      }
+      http::async_read_header(self->stream, self->buffer, state->parser, on_header);
+    };
+
+    http::async_write(stream, *request, std::move(on_write));
+  }
+
+  void close( ) override
+  {
+    error_t ec;
+    socket( ).shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    socket( ).close(ec);
+  }
+};
+
+using tcp_http_connection_t = BasicHttpConnection<boost::asio::ip::tcp::socket>;
+using ssl_http_connection_t = BasicHttpConnection<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>;
+}
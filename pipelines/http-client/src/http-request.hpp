@@ -0,0 +1,109 @@
+#pragma once
+#include "get-string.hpp"
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+
+namespace trawler {
+
+using http_request_t = boost::beast::http::request<boost::beast::http::string_body>;
+using http_response_t = boost::beast::http::response<boost::beast::http::string_body>;
+using http_response_header_t = boost::beast::http::response_header<>;
+
+/*******************************************************************************
+ * http_endpoint_t
+ *
+ * Where a request is sent.
+ ******************************************************************************/
+struct http_endpoint_t
+{
+  std::string host;
+  std::string port;
+};
+
+/*******************************************************************************
+ * make_http_request
+ *
+ * Builds a GET request from a payload like
+ *
+ *   { "host": "...", "port": "...", "target": "...", "version": "1.1", "headers": { ... } }
+ ******************************************************************************/
+inline std::pair<http_endpoint_t, std::shared_ptr<const http_request_t>>
+make_http_request(const nlohmann::json& payload)
+{
+  namespace http = boost::beast::http;
+
+  auto endpoint = http_endpoint_t{ get_string(payload, "host"), get_string(payload, "port") };
+  const auto target = get_string(payload, "target");
+  const auto version = get_string(payload, "version") == "1.0" ? 10 : 11;
+
+  auto request = std::make_shared<http_request_t>(http::verb::get, target, version);
+  request->set(http::field::host, endpoint.host);
+  request->set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+
+  const auto headers = payload.find("headers");
+  if (headers != cend(payload) && headers->is_object( )) {
+    for (auto it = headers->cbegin( ); it != headers->cend( ); ++it) {
+      request->set(it.key( ), it.value( ).get<nlohmann::json::string_t>( ));
+    }
+  }
+
+  return { std::move(endpoint), std::move(request) };
+}
+
+/*******************************************************************************
+ * make_http_request_key
+ *
+ * A key identifying requests that are bound to get the same response: the
+ * same upstream, method, target, version and headers.
+ ******************************************************************************/
+inline std::string
+make_http_request_key(const http_endpoint_t& endpoint, const http_request_t& request, bool ssl)
+{
+  auto key = std::string{ ssl ? "https://" : "http://" };
+  key += endpoint.host + ':' + endpoint.port + ' ';
+  key += std::string{ request.method_string( ) } + ' ' + std::string{ request.target( ) };
+  key += ' ' + std::to_string(request.version( ));
+  for (const auto& field : request) {
+    key += '\n' + std::string{ field.name_string( ) } + ": " + std::string{ field.value( ) };
+  }
+  return key;
+}
+
+/*******************************************************************************
+ * make_http_response_headers_json
+ ******************************************************************************/
+inline nlohmann::json
+make_http_response_headers_json(const http_response_header_t& header)
+{
+  auto json = nlohmann::json::object( );
+  for (const auto& field : header) {
+    json[std::string{ field.name_string( ) }] = std::string{ field.value( ) };
+  }
+  return json;
+}
+
+/*******************************************************************************
+ * make_http_response_json
+ *
+ * Converts a response into { "headers": { ... }, "body": ... }, where the body
+ * is parsed in place if the content type says it is json.
+ ******************************************************************************/
+inline nlohmann::json
+make_http_response_json(const http_response_t& response)
+{
+  namespace http = boost::beast::http;
+
+  auto json = nlohmann::json{ };
+  json["headers"] = make_http_response_headers_json(response.base( ));
+  if (boost::starts_with(response[http::field::content_type], "application/json")) {
+    json["body"] = nlohmann::json::parse(response.body( ));
+  } else {
+    json["body"] = response.body( );
+  }
+  return json;
+}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace trawler {
+
+/*******************************************************************************
+ * InFlightLimiter
+ *
+ * Runs at most `limit` jobs at once. Jobs submitted beyond that are queued and
+ * started in order as running jobs call release( ).
+ ******************************************************************************/
+class InFlightLimiter
+{
+  std::mutex mutex;
+  std::size_t limit;
+  std::size_t in_flight = 0;
+  std::deque<std::function<void( )>> queue;
+
+public:
+  explicit InFlightLimiter(std::size_t limit)
+    : limit{ limit > 0 ? limit : 1 }
+  {}
+
+  InFlightLimiter(const InFlightLimiter&) = delete;
+  InFlightLimiter(InFlightLimiter&&) = delete;
+  InFlightLimiter& operator=(const InFlightLimiter&) = delete;
+  InFlightLimiter& operator=(InFlightLimiter&&) = delete;
+  ~InFlightLimiter( ) = default;
+
+  void submit(std::function<void( )> job)
+  {
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      if (in_flight >= limit) {
+        queue.push_back(std::move(job));
+        return;
+      }
+      ++in_flight;
+    }
+    job( );
+  }
+
+  void release( )
+  {
+    std::function<void( )> next;
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      if (queue.empty( )) {
+        --in_flight;
+        return;
+      }
+      next = std::move(queue.front( ));
+      queue.pop_front( );
+    }
+    next( );
+  }
+};
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <cctype>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <trawler/pipelines/http-client/http-client.hpp>
+
+namespace trawler {
+
+/*******************************************************************************
+ * JsonStreamSplitter
+ *
+ * Splits a body arriving in arbitrary parts into the text of its elements:
+ * the non-blank lines of NDJSON, or the elements of a top level JSON array.
+ * Only the element being read is buffered, up to max_element_bytes (0 for no
+ * limit). Malformed input raises std::runtime_error.
+ ******************************************************************************/
+class JsonStreamSplitter
+{
+public:
+  using sink_t = std::function<void(std::string_view)>;
+
+private:
+  EHttpStreaming mode;
+  std::size_t max_element_bytes;
+  std::string element;
+
+  // Where the scanner is in a JSON array
+  bool array_started = false;
+  bool array_ended = false;
+  bool in_string = false;
+  bool escaped = false;
+  std::size_t depth = 0;
+
+  static bool is_blank(std::string_view text)
+  {
+    for (const auto c : text) {
+      if (!std::isspace(static_cast<unsigned char>(c))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void check_size(std::size_t size) const
+  {
+    if (max_element_bytes > 0 && size > max_element_bytes) {
+      throw std::runtime_error{ "Element exceeds " + std::to_string(max_element_bytes) + " bytes" };
+    }
+  }
+
+  void append(std::string_view text)
+  {
+    check_size(element.size( ) + text.size( ));
+    element.append(text.data( ), text.size( ));
+  }
+
+  void feed_lines(std::string_view chunk, const sink_t& sink)
+  {
+    for (auto newline = chunk.find('\n'); newline != std::string_view::npos; newline = chunk.find('\n')) {
+      // Lines that arrived whole are handed over without being copied
+      auto line = chunk.substr(0, newline);
+      if (!element.empty( )) {
+        append(line);
+        line = element;
+      } else {
+        check_size(line.size( ));
+      }
+      if (!is_blank(line)) {
+        sink(line);
+      }
+      element.clear( );
+      chunk.remove_prefix(newline + 1);
+    }
+    append(chunk);
+  }
+
+  void emit_array_element(const sink_t& sink)
+  {
+    if (is_blank(element)) {
+      throw std::runtime_error{ "Empty element in JSON array" };
+    }
+    sink(element);
+    element.clear( );
+  }
+
+  void feed_array(std::string_view chunk, const sink_t& sink)
+  {
+    for (const auto c : chunk) {
+      const auto space = std::isspace(static_cast<unsigned char>(c)) != 0;
+
+      if (!array_started || array_ended) {
+        if (space) {
+          continue;
+        }
+        if (array_ended || c != '[') {
+          throw std::runtime_error{ "Body is not a single JSON array" };
+        }
+        array_started = true;
+        continue;
+      }
+
+      if (in_string) {
+        if (escaped) {
+          escaped = false;
+        } else if (c == '\\') {
+          escaped = true;
+        } else if (c == '"') {
+          in_string = false;
+        }
+      } else if (c == '"') {
+        in_string = true;
+      } else if (c == '[' || c == '{') {
+        ++depth;
+      } else if ((c == ']' || c == '}') && depth > 0) {
+        --depth;
+      } else if (c == ',' && depth == 0) {
+        emit_array_element(sink);
+        continue;
+      } else if (c == ']') {
+        if (!is_blank(element)) {
+          emit_array_element(sink);
+        }
+        array_ended = true;
+        continue;
+      } else if (space && depth == 0 && element.empty( )) {
+        continue;
+      }
+      append(std::string_view{ &c, 1 });
+    }
+  }
+
+public:
+  JsonStreamSplitter(EHttpStreaming mode, std::size_t max_element_bytes)
+    : mode{ mode }
+    , max_element_bytes{ max_element_bytes }
+  {}
+
+  void feed(std::string_view chunk, const sink_t& sink)
+  {
+    if (mode == EHttpStreaming::NDJSON) {
+      feed_lines(chunk, sink);
+    } else {
+      feed_array(chunk, sink);
+    }
+  }
+
+  // Hands over what is left once the body is complete
+  void finish(const sink_t& sink)
+  {
+    if (mode == EHttpStreaming::NDJSON) {
+      if (!is_blank(element)) {
+        sink(element);
+      }
+      element.clear( );
+    } else if (array_started && !array_ended) {
+      throw std::runtime_error{ "JSON array is incomplete" };
+    }
+  }
+};
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace trawler {
+
+/*******************************************************************************
+ * LatencyTracker
+ *
+ * Keeps the most recent response times in a ring buffer and estimates their
+ * percentiles, once enough of them have been seen to be meaningful.
+ ******************************************************************************/
+class LatencyTracker
+{
+public:
+  using duration_t = std::chrono::steady_clock::duration;
+
+private:
+  static constexpr std::size_t min_samples = 16;
+
+  std::mutex mutex;
+  std::vector<duration_t> samples;
+  std::size_t next = 0;
+  std::size_t window;
+
+public:
+  explicit LatencyTracker(std::size_t window = 256)
+    : window{ std::max(window, min_samples) }
+  {
+    samples.reserve(this->window);
+  }
+
+  LatencyTracker(const LatencyTracker&) = delete;
+  LatencyTracker(LatencyTracker&&) = delete;
+  LatencyTracker& operator=(const LatencyTracker&) = delete;
+  LatencyTracker& operator=(LatencyTracker&&) = delete;
+  ~LatencyTracker( ) = default;
+
+  void record(duration_t latency)
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (samples.size( ) < window) {
+      samples.push_back(latency);
+    } else {
+      samples[next] = latency;
+    }
+    next = (next + 1) % window;
+  }
+
+  // Returns the given percentile (0-100) of the recent response times
+  std::optional<duration_t> percentile(double p)
+  {
+    auto sorted = std::vector<duration_t>{ };
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      if (samples.size( ) < min_samples) {
+        return std::nullopt;
+      }
+      sorted = samples;
+    }
+
+    const auto rank = static_cast<std::size_t>(std::clamp(p, 0.0, 100.0) / 100.0 * (sorted.size( ) - 1));
+    std::nth_element(begin(sorted), begin(sorted) + rank, end(sorted));
+    return sorted[rank];
+  }
+};
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace trawler {
+
+/*******************************************************************************
+ * RequestCoalescer
+ *
+ * Folds identical requests in flight into one. The first caller to join a key
+ * performs the request and calls complete( ), which hands the result to every
+ * caller that joined the key in the meantime. Callers may tell how to check
+ * whether they gave up on the result, so the request can be skipped once all
+ * of them did.
+ ******************************************************************************/
+template<typename Result>
+class RequestCoalescer
+{
+public:
+  using callback_t = std::function<void(const Result&)>;
+  using abandoned_t = std::function<bool( )>;
+
+private:
+  struct waiter_t
+  {
+    callback_t callback;
+    abandoned_t abandoned;
+  };
+
+  std::mutex mutex;
+  std::map<std::string, std::vector<waiter_t>> waiting;
+
+public:
+  RequestCoalescer( ) = default;
+  RequestCoalescer(const RequestCoalescer&) = delete;
+  RequestCoalescer(RequestCoalescer&&) = delete;
+  RequestCoalescer& operator=(const RequestCoalescer&) = delete;
+  RequestCoalescer& operator=(RequestCoalescer&&) = delete;
+  ~RequestCoalescer( ) = default;
+
+  // Returns true if the caller is the first for the key and should perform the request
+  bool join(const std::string& key, callback_t callback, abandoned_t abandoned = nullptr)
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    auto& waiters = waiting[key];
+    waiters.push_back({ std::move(callback), std::move(abandoned) });
+    return waiters.size( ) == 1;
+  }
+
+  // Returns true if every caller waiting for the key has given up on the result
+  bool abandoned(const std::string& key)
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    const auto found = waiting.find(key);
+    if (found == end(waiting)) {
+      return true;
+    }
+    return std::all_of(cbegin(found->second), cend(found->second), [](const waiter_t& waiter) {
+      return waiter.abandoned && waiter.abandoned( );
+    });
+  }
+
+  void complete(const std::string& key, const Result& result)
+  {
+    auto waiters = std::vector<waiter_t>{ };
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      const auto found = waiting.find(key);
+      if (found == end(waiting)) {
+        return;
+      }
+      waiters = std::move(found->second);
+      waiting.erase(found);
+    }
+    for (const auto& waiter : waiters) {
+      waiter.callback(result);
+    }
+  }
+};
+}
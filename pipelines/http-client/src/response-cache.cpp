@@ -0,0 +1,223 @@
+#include "response-cache.hpp"
+#include <boost/algorithm/string.hpp>
+#include <vector>
+
+namespace trawler {
+
+namespace {
+
+namespace http = boost::beast::http;
+
+std::size_t
+approximate_size(const http_response_t& response)
+{
+  auto size = response.body( ).size( );
+  for (const auto& field : response) {
+    size += field.name_string( ).size( ) + field.value( ).size( );
+  }
+  return size;
+}
+
+std::chrono::seconds
+get_age(const http_response_t& response)
+{
+  try {
+    return std::chrono::seconds{ std::stol(std::string{ response[http::field::age] }) };
+  } catch (const std::exception&) {
+    return std::chrono::seconds{ 0 };
+  }
+}
+}
+
+cache_control_t
+parse_cache_control(const std::string& header)
+{
+  auto result = cache_control_t{ };
+
+  auto directives = std::vector<std::string>{ };
+  boost::split(directives, header, boost::is_any_of(","));
+
+  for (auto& directive : directives) {
+    boost::trim(directive);
+    boost::to_lower(directive);
+
+    const auto separator = directive.find('=');
+    const auto name = directive.substr(0, separator);
+    const auto value = separator == std::string::npos ? std::string{ } : directive.substr(separator + 1);
+
+    auto seconds = [&value]( ) -> std::optional<long> {
+      try {
+        return std::stol(boost::trim_copy_if(value, boost::is_any_of("\"")));
+      } catch (const std::exception&) {
+        return std::nullopt;
+      }
+    };
+
+    if (name == "no-store") {
+      result.no_store = true;
+    } else if (name == "no-cache") {
+      result.no_cache = true;
+    } else if (name == "max-age") {
+      result.max_age = seconds( );
+    } else if (name == "stale-while-revalidate") {
+      result.stale_while_revalidate = seconds( ).value_or(0);
+    }
+  }
+
+  return result;
+}
+
+ResponseCache::ResponseCache(std::size_t max_bytes)
+  : max_bytes{ max_bytes }
+{}
+
+void
+ResponseCache::erase(std::map<std::string, lru_t::iterator>::iterator it)
+{
+  bytes -= it->second->size;
+  lru.erase(it->second);
+  entries.erase(it);
+}
+
+ResponseCache::lookup_t
+ResponseCache::lookup(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock{ mutex };
+
+  const auto found = entries.find(key);
+  if (found == end(entries)) {
+    return { };
+  }
+
+  // Move to the front, the back is evicted first
+  lru.splice(begin(lru), lru, found->second);
+  const auto& entry = *found->second;
+
+  const auto now = clock_t::now( );
+  auto freshness = EFreshness::STALE;
+  if (now < entry.fresh_until) {
+    freshness = EFreshness::FRESH;
+  } else if (now < entry.usable_until) {
+    freshness = EFreshness::STALE_WHILE_REVALIDATE;
+  }
+
+  return { freshness, entry.payload, entry.etag, entry.last_modified };
+}
+
+bool
+ResponseCache::start_revalidation(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock{ mutex };
+
+  const auto found = entries.find(key);
+  if (found == end(entries) || found->second->revalidating) {
+    return false;
+  }
+  found->second->revalidating = true;
+  return true;
+}
+
+void
+ResponseCache::store(const std::string& key, const http_response_t& response, payload_tp payload)
+{
+  if (response.result( ) != http::status::ok) {
+    return;
+  }
+
+  const auto cache_control = parse_cache_control(std::string{ response[http::field::cache_control] });
+  auto etag = std::string{ response[http::field::etag] };
+  auto last_modified = std::string{ response[http::field::last_modified] };
+
+  // Without a lifetime a response is only worth keeping if it can be revalidated
+  const auto revalidatable = !etag.empty( ) || !last_modified.empty( );
+  if (cache_control.no_store || (!cache_control.max_age && !revalidatable)) {
+    remove(key);
+    return;
+  }
+
+  const auto now = clock_t::now( );
+  const auto max_age = cache_control.no_cache ? std::chrono::seconds{ 0 }
+                                              : std::chrono::seconds{ cache_control.max_age.value_or(0) };
+  const auto stale_while_revalidate = std::chrono::seconds{ cache_control.stale_while_revalidate };
+  const auto fresh_until = now + max_age - get_age(response);
+  const auto usable_until = fresh_until + stale_while_revalidate;
+  const auto size = approximate_size(response) + key.size( );
+
+  std::lock_guard<std::mutex> lock{ mutex };
+
+  const auto found = entries.find(key);
+  if (found != end(entries)) {
+    erase(found);
+  }
+
+  if (size > max_bytes) {
+    return;
+  }
+
+  while (bytes + size > max_bytes && !lru.empty( )) {
+    erase(entries.find(lru.back( ).key));
+  }
+
+  lru.push_front(entry_t{ key,
+                          std::move(payload),
+                          std::move(etag),
+                          std::move(last_modified),
+                          fresh_until,
+                          usable_until,
+                          max_age,
+                          stale_while_revalidate,
+                          size,
+                          false });
+  entries[key] = begin(lru);
+  bytes += size;
+}
+
+void
+ResponseCache::refresh(const std::string& key, const http_response_t& response)
+{
+  const auto cache_control = parse_cache_control(std::string{ response[http::field::cache_control] });
+
+  std::lock_guard<std::mutex> lock{ mutex };
+
+  const auto found = entries.find(key);
+  if (found == end(entries)) {
+    return;
+  }
+
+  auto& entry = *found->second;
+  const auto now = clock_t::now( );
+
+  // A 304 may update the lifetime, otherwise the one the response was stored with starts over
+  if (cache_control.max_age || cache_control.no_cache) {
+    entry.max_age = std::chrono::seconds{ cache_control.no_cache ? 0L : *cache_control.max_age };
+    entry.stale_while_revalidate = std::chrono::seconds{ cache_control.stale_while_revalidate };
+  }
+  entry.fresh_until = now + entry.max_age - get_age(response);
+  entry.usable_until = entry.fresh_until + entry.stale_while_revalidate;
+  entry.revalidating = false;
+}
+
+void
+ResponseCache::remove(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock{ mutex };
+
+  const auto found = entries.find(key);
+  if (found != end(entries)) {
+    erase(found);
+  }
+}
+
+std::shared_ptr<const http_request_t>
+make_conditional_request(const http_request_t& request, const ResponseCache::lookup_t& cached)
+{
+  auto conditional = std::make_shared<http_request_t>(request);
+  if (!cached.etag.empty( )) {
+    conditional->set(http::field::if_none_match, cached.etag);
+  }
+  if (!cached.last_modified.empty( )) {
+    conditional->set(http::field::if_modified_since, cached.last_modified);
+  }
+  return conditional;
+}
+}
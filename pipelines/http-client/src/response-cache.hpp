@@ -0,0 +1,120 @@
+#pragma once
+#include "http-request.hpp"
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <trawler/services/service-packet.hpp>
+
+namespace trawler {
+
+/*******************************************************************************
+ * cache_control_t
+ *
+ * The parts of a Cache-Control header the response cache cares about.
+ ******************************************************************************/
+struct cache_control_t
+{
+  bool no_store = false;
+  bool no_cache = false;
+  std::optional<long> max_age;
+  long stale_while_revalidate = 0;
+};
+
+cache_control_t
+parse_cache_control(const std::string& header);
+
+/*******************************************************************************
+ * ResponseCache
+ *
+ * An in-memory cache of upstream responses, bounded by an approximate number
+ * of bytes and evicting the least recently used response first. Freshness
+ * follows Cache-Control max-age, responses with an ETag or Last-Modified can be
+ * revalidated once stale, and stale-while-revalidate lets a stale response be
+ * served while it is revalidated in the background.
+ ******************************************************************************/
+class ResponseCache
+{
+public:
+  using clock_t = std::chrono::steady_clock;
+  using payload_tp = ServicePacket::shared_payload_t;
+
+  enum class EFreshness
+  {
+    MISS,
+    FRESH,
+    STALE_WHILE_REVALIDATE,
+    STALE
+  };
+
+  struct lookup_t
+  {
+    EFreshness freshness = EFreshness::MISS;
+    payload_tp payload = nullptr;
+    std::string etag = "";
+    std::string last_modified = "";
+  };
+
+private:
+  struct entry_t
+  {
+    std::string key;
+    payload_tp payload;
+    std::string etag;
+    std::string last_modified;
+    clock_t::time_point fresh_until;
+    clock_t::time_point usable_until;
+    // Reapplied when a 304 doesn't come with a Cache-Control of its own
+    clock_t::duration max_age;
+    clock_t::duration stale_while_revalidate;
+    std::size_t size;
+    bool revalidating;
+  };
+
+  using lru_t = std::list<entry_t>;
+
+  std::mutex mutex;
+  std::size_t max_bytes;
+  std::size_t bytes = 0;
+  lru_t lru;
+  std::map<std::string, lru_t::iterator> entries;
+
+  void erase(std::map<std::string, lru_t::iterator>::iterator it);
+
+public:
+  explicit ResponseCache(std::size_t max_bytes);
+
+  ResponseCache(const ResponseCache&) = delete;
+  ResponseCache(ResponseCache&&) = delete;
+  ResponseCache& operator=(const ResponseCache&) = delete;
+  ResponseCache& operator=(ResponseCache&&) = delete;
+  ~ResponseCache( ) = default;
+
+  lookup_t lookup(const std::string& key);
+
+  // Marks a response served stale-while-revalidate as being revalidated, returns
+  // false if someone else already does
+  bool start_revalidation(const std::string& key);
+
+  // Stores a 200 response if its headers allow it
+  void store(const std::string& key, const http_response_t& response, payload_tp payload);
+
+  // Renews the freshness of a stored response from a 304 response
+  void refresh(const std::string& key, const http_response_t& response);
+
+  // Drops a response, for instance when it could not be revalidated
+  void remove(const std::string& key);
+};
+
+/*******************************************************************************
+ * make_conditional_request
+ *
+ * Returns a copy of request asking the upstream to answer 304 Not Modified if
+ * the cached response is still valid.
+ ******************************************************************************/
+std::shared_ptr<const http_request_t>
+make_conditional_request(const http_request_t& request, const ResponseCache::lookup_t& cached);
+}
@@ -0,0 +1,225 @@
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <trawler/pipelines/http-client/scatter-gather.hpp>
+#include <vector>
+
+namespace trawler {
+
+namespace {
+
+/*******************************************************************************
+ * Gather
+ *
+ * Collects the outcome of every call of one scatter-gather. Each call settles
+ * once, whatever comes first; settling the last one completes the gather.
+ * Calls still outstanding once the gather completes are unsubscribed from.
+ ******************************************************************************/
+class Gather
+{
+  std::mutex mutex;
+  nlohmann::json responses;
+  nlohmann::json errors = nlohmann::json::array( );
+  std::vector<bool> settled;
+  std::size_t pending;
+  std::vector<rxcpp::composite_subscription> calls;
+  bool cancelled = false;
+
+  // Expects the lock to be held
+  bool settle(std::size_t index)
+  {
+    if (settled[index]) {
+      return false;
+    }
+    settled[index] = true;
+    --pending;
+    return true;
+  }
+
+public:
+  // The timer handler and the settling of calls run on the strand, anything else touching the timer is posted there
+  boost::asio::strand<boost::asio::io_context::executor_type> strand;
+  boost::asio::steady_timer timer;
+
+  Gather(boost::asio::io_context& context, std::size_t nof_calls)
+    : responses(nof_calls, nullptr)
+    , settled(nof_calls, false)
+    , pending{ nof_calls }
+    , strand{ context.get_executor( ) }
+    , timer{ context }
+  {}
+
+  Gather(const Gather&) = delete;
+  Gather(Gather&&) = delete;
+  Gather& operator=(const Gather&) = delete;
+  Gather& operator=(Gather&&) = delete;
+  ~Gather( ) = default;
+
+  // The following return true if they completed the gather
+
+  bool set_response(std::size_t index, nlohmann::json response)
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (settle(index)) {
+      responses[index] = std::move(response);
+      return pending == 0;
+    }
+    return false;
+  }
+
+  bool set_error(std::size_t index, const std::string& error)
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (settle(index)) {
+      errors.push_back({ { "index", index }, { "error", error } });
+      return pending == 0;
+    }
+    return false;
+  }
+
+  bool expire( )
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (pending == 0) {
+      return false;
+    }
+    for (auto index = 0U; index < settled.size( ); ++index) {
+      if (settle(index)) {
+        errors.push_back({ { "index", index }, { "error", "timed out" } });
+      }
+    }
+    return true;
+  }
+
+  void add_call(rxcpp::composite_subscription call)
+  {
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      if (!cancelled) {
+        calls.push_back(std::move(call));
+        return;
+      }
+    }
+    call.unsubscribe( );
+  }
+
+  // Gives up on the calls still outstanding, those still queued by the http-client are never made
+  void cancel_calls( )
+  {
+    auto outstanding = std::vector<rxcpp::composite_subscription>{ };
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      cancelled = true;
+      outstanding.swap(calls);
+    }
+    for (auto& call : outstanding) {
+      call.unsubscribe( );
+    }
+  }
+
+  nlohmann::json result( )
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    return { { "responses", std::move(responses) }, { "errors", std::move(errors) } };
+  }
+};
+
+nlohmann::json
+get_request_descriptors(const nlohmann::json& payload)
+{
+  const auto& descriptors = payload.is_array( ) ? payload : payload.at("requests");
+  if (!descriptors.is_array( )) {
+    throw std::runtime_error{ "Expected a list of requests" };
+  }
+  return descriptors;
+}
+}
+
+std::function<rxcpp::observable<ServicePacket>(const ServicePacket&)>
+create_http_scatter_gather_pipeline(const std::shared_ptr<ServiceContext>& context,
+                                    const http_scatter_gather_options_t& options,
+                                    const Logger& logger)
+{
+  auto client_options = options.client;
+  client_options.streaming = EHttpStreaming::NONE;
+  const auto http_client = create_http_client_pipeline(context, client_options, logger);
+  const auto timeout = options.timeout;
+  auto service_strand = make_service_strand(context);
+
+  return [=](const ServicePacket& packet) {
+    // Handlers hold a copy of the strand only, the shared one keeps the context alive
+    return rxcpp::observable<>::create<ServicePacket>([=, strand = *service_strand](auto subscriber) {
+      auto descriptors = nlohmann::json{ };
+      try {
+        descriptors = get_request_descriptors(*packet.get_payload_view<nlohmann::json>( ));
+      } catch (const std::exception& e) {
+        logger.critical(std::string{ "Invalid requests: " } + e.what( ));
+        boost::asio::post(strand, [=] { subscriber.on_completed( ); });
+        return;
+      }
+
+      auto gather = std::make_shared<Gather>(context->get_session_context( ), descriptors.size( ));
+
+      auto emit = [=]( ) {
+        gather->cancel_calls( );
+        boost::asio::post(gather->strand, [gather] { gather->timer.cancel( ); });
+        boost::asio::post(strand, [=] {
+          if (packet.is_expired( )) {
+            packet.expire( );
+          } else {
+            subscriber.on_next(packet.with_payload(gather->result( )));
+          }
+          subscriber.on_completed( );
+        });
+      };
+
+      if (descriptors.empty( )) {
+        emit( );
+        return;
+      }
+
+      // Calls still outstanding when the packet's deadline passes are given up on along with it. They carry the
+      // deadline without a way of expiring the packet, the gathered result is what expires it
+      const auto& deadline = packet.get_deadline( );
+      const auto call_deadline = deadline ? ServicePacket::make_deadline(deadline->at) : nullptr;
+      if (timeout.count( ) > 0 || deadline) {
+        const auto expiry = ServicePacket::clock_t::now( ) + timeout;
+        gather->timer.expires_at(deadline && (timeout.count( ) == 0 || deadline->at < expiry) ? deadline->at : expiry);
+        auto on_timeout = [gather, emit](boost::system::error_code ec) {
+          if (!ec && gather->expire( )) {
+            emit( );
+          }
+        };
+        gather->timer.async_wait(boost::asio::bind_executor(gather->strand, std::move(on_timeout)));
+      }
+
+      // Calls are issued all at once, the http-client pipeline bounds how many are actually in flight
+      for (auto index = std::size_t{ 0 }; index < descriptors.size( ); ++index) {
+        auto on_response = [gather, emit, index](const ServicePacket& response) {
+          boost::asio::post(gather->strand, [gather, emit, index, response] {
+            if (gather->set_response(index, response.get_payload_as<nlohmann::json>( ))) {
+              emit( );
+            }
+          });
+        };
+
+        // Failed calls complete without a response
+        auto on_completed = [gather, emit, index]( ) {
+          boost::asio::post(gather->strand, [gather, emit, index] {
+            if (gather->set_error(index, "request failed")) {
+              emit( );
+            }
+          });
+        };
+
+        gather->add_call(
+          http_client(packet.with_payload(std::move(descriptors[index])).with_deadline(call_deadline))
+            .subscribe(on_response, on_completed));
+      }
+    });
+  };
+}
+}
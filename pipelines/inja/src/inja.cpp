@@ -1,5 +1,6 @@
 #include <inja.hpp>
 #include <iostream>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <trawler/pipelines/inja/inja.hpp>
 
@@ -10,11 +11,17 @@ using json = nlohmann::json;
 std::function<ServicePacket(ServicePacket)>
 create_inja_pipeline(const std::string& tmplate, const Logger& logger)
 {
+  // The template is lexed and parsed once, packets are rendered against the parsed form
+  auto environment = std::make_shared<inja::Environment>( );
+  auto compiled = std::make_shared<const inja::Template>(environment->parse(tmplate));
+
   return [=](const auto& x) {
-    const auto payload = x.template get_payload_as<json>( );
-    logger.debug("Payload " + payload.dump( ));
-    auto result = inja::render(tmplate, payload);
-    return x.with_payload(result);
+    const auto payload = x.template get_payload_view<json>( );
+    if (logger.should_log(Logger::ELogLevel::DEBUG)) {
+      logger.debug("Payload " + *x.template get_payload_view<std::string>( ));
+    }
+    auto result = environment->render_template(*compiled, *payload);
+    return x.with_payload(std::move(result));
   };
 }
 }
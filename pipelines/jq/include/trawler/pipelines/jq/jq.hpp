@@ -7,6 +7,37 @@
 
 namespace trawler {
 
+/*******************************************************************************
+ * EJqBackend
+ *
+ * AUTO evaluates scripts within the natively supported subset of jq directly on
+ * json payloads and everything else with libjq. NATIVE is AUTO for scripts that
+ * must be within the subset, creating the pipeline throws if they are not.
+ * INTERPRETER always uses libjq.
+ ******************************************************************************/
+enum class EJqBackend
+{
+  AUTO,
+  NATIVE,
+  INTERPRETER
+};
+
+using jq_emit_t = std::function<void(const ServicePacket&)>;
+using jq_stage_t = std::function<void(const ServicePacket&, const jq_emit_t&)>;
+
+/*******************************************************************************
+ * create_jq_stage
+ *
+ * The push based form of the jq pipeline: calls emit with every result as it is
+ * produced, rather than returning an observable of the results per packet.
+ ******************************************************************************/
+jq_stage_t
+create_jq_stage(const std::string& script,
+                const Logger& logger = { "jq" },
+                EJqBackend backend = EJqBackend::AUTO);
+
 std::function<rxcpp::observable<ServicePacket>(const ServicePacket&)>
-create_jq_pipeline(const std::string& script, const Logger& logger = { "jq" });
+create_jq_pipeline(const std::string& script,
+                   const Logger& logger = { "jq" },
+                   EJqBackend backend = EJqBackend::AUTO);
 }
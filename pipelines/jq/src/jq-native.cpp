@@ -0,0 +1,714 @@
+#include "jq-native.hpp"
+#include "jv-json.hpp"
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+namespace trawler {
+
+namespace {
+
+using json = nlohmann::json;
+using sink_t = jq_native_sink_t;
+using filter_t = jq_native_filter_t;
+
+const json null_json{ };
+
+// Thrown by the compiler when the script leaves the supported subset
+struct unsupported
+{};
+
+/*******************************************************************************
+ * node_t
+ *
+ * A compiled filter and whether it produces at most one result per input.
+ ******************************************************************************/
+struct node_t
+{
+  filter_t filter;
+  bool single;
+};
+
+/*******************************************************************************
+ * jq semantics
+ ******************************************************************************/
+enum class EKind
+{
+  NULL_,
+  FALSE_,
+  TRUE_,
+  NUMBER,
+  STRING,
+  ARRAY,
+  OBJECT
+};
+
+EKind
+kind_of(const json& value)
+{
+  switch (value.type( )) {
+    case json::value_t::boolean:
+      return value.get<bool>( ) ? EKind::TRUE_ : EKind::FALSE_;
+    case json::value_t::number_integer:
+    case json::value_t::number_unsigned:
+    case json::value_t::number_float:
+      return EKind::NUMBER;
+    case json::value_t::string:
+      return EKind::STRING;
+    case json::value_t::array:
+      return EKind::ARRAY;
+    case json::value_t::object:
+      return EKind::OBJECT;
+    default:
+      return EKind::NULL_;
+  }
+}
+
+std::string
+kind_name(const json& value)
+{
+  switch (kind_of(value)) {
+    case EKind::FALSE_:
+    case EKind::TRUE_:
+      return "boolean";
+    case EKind::NUMBER:
+      return "number";
+    case EKind::STRING:
+      return "string";
+    case EKind::ARRAY:
+      return "array";
+    case EKind::OBJECT:
+      return "object";
+    default:
+      return "null";
+  }
+}
+
+bool
+is_truthy(const json& value)
+{
+  return !(value.is_null( ) || (value.is_boolean( ) && !value.get<bool>( )));
+}
+
+// Mirrors jv_contains
+bool
+contains(const json& a, const json& b)
+{
+  if (kind_of(a) != kind_of(b)) {
+    return false;
+  }
+
+  switch (kind_of(a)) {
+    case EKind::OBJECT:
+      for (auto it = b.cbegin( ); it != b.cend( ); ++it) {
+        const auto found = a.find(it.key( ));
+        if (found == a.cend( ) || !contains(*found, it.value( ))) {
+          return false;
+        }
+      }
+      return true;
+    case EKind::ARRAY:
+      for (const auto& needle : b) {
+        auto found = false;
+        for (const auto& element : a) {
+          if (contains(element, needle)) {
+            found = true;
+            break;
+          }
+        }
+        if (!found) {
+          return false;
+        }
+      }
+      return true;
+    case EKind::STRING:
+      return a.get_ref<const json::string_t&>( ).find(b.get_ref<const json::string_t&>( )) != std::string::npos;
+    case EKind::NUMBER:
+      return a.get<double>( ) == b.get<double>( );
+    default:
+      return true;
+  }
+}
+
+std::size_t
+count_codepoints(const std::string& string)
+{
+  auto count = std::size_t{ 0 };
+  for (const auto c : string) {
+    if ((static_cast<unsigned char>(c) & 0xC0U) != 0x80U) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+/*******************************************************************************
+ * Filters
+ ******************************************************************************/
+node_t
+make_identity( )
+{
+  return { [](const json& input, const sink_t& sink) { sink(input); }, true };
+}
+
+node_t
+make_literal(json value)
+{
+  return { [value = std::move(value)](const json&, const sink_t& sink) { sink(value); }, true };
+}
+
+node_t
+make_field(const std::string& key)
+{
+  auto filter = [key](const json& input, const sink_t& sink) {
+    if (input.is_null( )) {
+      sink(null_json);
+      return;
+    }
+    if (!input.is_object( )) {
+      throw jq_native_error{ "Cannot index " + kind_name(input) + " with \"" + key + "\"" };
+    }
+    const auto found = input.find(key);
+    sink(found == input.cend( ) ? null_json : *found);
+  };
+  return { std::move(filter), true };
+}
+
+node_t
+make_index(long index)
+{
+  auto filter = [index](const json& input, const sink_t& sink) {
+    if (input.is_null( )) {
+      sink(null_json);
+      return;
+    }
+    if (!input.is_array( )) {
+      throw jq_native_error{ "Cannot index " + kind_name(input) + " with number" };
+    }
+    const auto size = static_cast<long>(input.size( ));
+    const auto position = index < 0 ? index + size : index;
+    sink(position < 0 || position >= size ? null_json : input[static_cast<std::size_t>(position)]);
+  };
+  return { std::move(filter), true };
+}
+
+node_t
+make_pipe(node_t lhs, node_t rhs)
+{
+  auto filter = [lhs = std::move(lhs.filter), rhs = std::move(rhs.filter)](const json& input, const sink_t& sink) {
+    lhs(input, [&](const json& value) { rhs(value, sink); });
+  };
+  return { std::move(filter), lhs.single && rhs.single };
+}
+
+node_t
+make_comma(std::vector<node_t> nodes)
+{
+  auto filters = std::vector<filter_t>{ };
+  for (auto& node : nodes) {
+    filters.push_back(std::move(node.filter));
+  }
+  auto filter = [filters = std::move(filters)](const json& input, const sink_t& sink) {
+    for (const auto& filter : filters) {
+      filter(input, sink);
+    }
+  };
+  return { std::move(filter), false };
+}
+
+node_t
+make_array(node_t element)
+{
+  auto filter = [element = std::move(element.filter)](const json& input, const sink_t& sink) {
+    auto result = json::array( );
+    element(input, [&](const json& value) { result.push_back(value); });
+    sink(result);
+  };
+  return { std::move(filter), true };
+}
+
+node_t
+make_object(std::vector<std::pair<std::string, node_t>> pairs)
+{
+  // With several results per value jq builds the cartesian product, whose order
+  // we do not reproduce, so only values with at most one result are supported
+  auto entries = std::vector<std::pair<std::string, filter_t>>{ };
+  for (auto& [key, node] : pairs) {
+    if (!node.single) {
+      throw unsupported{ };
+    }
+    entries.emplace_back(key, std::move(node.filter));
+  }
+
+  auto filter = [entries = std::move(entries)](const json& input, const sink_t& sink) {
+    auto result = json::object( );
+    for (const auto& [key, value_filter] : entries) {
+      auto produced = false;
+      value_filter(input, [&, &key = key](const json& value) {
+        result[key] = value;
+        produced = true;
+      });
+      if (!produced) {
+        return;
+      }
+    }
+    sink(result);
+  };
+  return { std::move(filter), true };
+}
+
+node_t
+make_select(node_t condition)
+{
+  auto filter = [condition = std::move(condition.filter)](const json& input, const sink_t& sink) {
+    condition(input, [&](const json& value) {
+      if (is_truthy(value)) {
+        sink(input);
+      }
+    });
+  };
+  return { std::move(filter), condition.single };
+}
+
+node_t
+make_contains(node_t needle)
+{
+  auto filter = [needle = std::move(needle.filter)](const json& input, const sink_t& sink) {
+    needle(input, [&](const json& value) {
+      if (kind_of(input) != kind_of(value)) {
+        throw jq_native_error{ kind_name(input) + " and " + kind_name(value) +
+                               " cannot have their containment checked" };
+      }
+      sink(json(contains(input, value)));
+    });
+  };
+  return { std::move(filter), needle.single };
+}
+
+template<typename Predicate>
+node_t
+make_type_filter(Predicate predicate)
+{
+  auto filter = [predicate](const json& input, const sink_t& sink) {
+    if (predicate(input)) {
+      sink(input);
+    }
+  };
+  return { std::move(filter), true };
+}
+
+node_t
+make_not( )
+{
+  return { [](const json& input, const sink_t& sink) { sink(json(!is_truthy(input))); }, true };
+}
+
+node_t
+make_empty( )
+{
+  return { [](const json&, const sink_t&) {}, true };
+}
+
+node_t
+make_length( )
+{
+  auto filter = [](const json& input, const sink_t& sink) {
+    switch (kind_of(input)) {
+      case EKind::NULL_:
+        sink(json(0));
+        break;
+      case EKind::NUMBER:
+        sink(to_json_number(std::fabs(input.get<double>( ))));
+        break;
+      case EKind::STRING:
+        sink(json(count_codepoints(input.get_ref<const json::string_t&>( ))));
+        break;
+      case EKind::ARRAY:
+      case EKind::OBJECT:
+        sink(json(input.size( )));
+        break;
+      default:
+        throw jq_native_error{ "boolean (" + input.dump( ) + ") has no length" };
+    }
+  };
+  return { std::move(filter), true };
+}
+
+/*******************************************************************************
+ * Parser
+ *
+ * A recursive descent parser for the supported subset of the jq grammar. It
+ * bails out with `unsupported` on anything it does not recognize, leaving
+ * the script to libjq.
+ ******************************************************************************/
+class Parser
+{
+  const std::string& text;
+  std::size_t pos = 0;
+
+  static bool is_ident_start(char c) { return std::isalpha(static_cast<unsigned char>(c)) || c == '_'; }
+  static bool is_ident_char(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+  char peek(std::size_t offset = 0) const { return pos + offset < text.size( ) ? text[pos + offset] : '\0'; }
+
+  void skip_whitespace( )
+  {
+    while (pos < text.size( )) {
+      if (std::isspace(static_cast<unsigned char>(text[pos]))) {
+        ++pos;
+      } else if (text[pos] == '#') {
+        while (pos < text.size( ) && text[pos] != '\n') {
+          ++pos;
+        }
+      } else {
+        break;
+      }
+    }
+  }
+
+  bool accept(char c)
+  {
+    skip_whitespace( );
+    if (peek( ) == c) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c)
+  {
+    if (!accept(c)) {
+      throw unsupported{ };
+    }
+  }
+
+  std::string identifier( )
+  {
+    const auto start = pos;
+    while (is_ident_char(peek( ))) {
+      ++pos;
+    }
+    return text.substr(start, pos - start);
+  }
+
+  json string_literal( )
+  {
+    const auto start = pos++;
+    while (pos < text.size( ) && text[pos] != '"') {
+      if (text[pos] == '\\') {
+        // String interpolation is left to libjq
+        if (peek(1) == '(') {
+          throw unsupported{ };
+        }
+        ++pos;
+      }
+      ++pos;
+    }
+    if (pos++ >= text.size( )) {
+      throw unsupported{ };
+    }
+    try {
+      return json::parse(text.substr(start, pos - start));
+    } catch (const json::exception&) {
+      throw unsupported{ };
+    }
+  }
+
+  void digits( )
+  {
+    while (std::isdigit(static_cast<unsigned char>(peek( )))) {
+      ++pos;
+    }
+  }
+
+  json number_literal( )
+  {
+    const auto start = pos;
+    digits( );
+    if (peek( ) == '.') {
+      ++pos;
+      digits( );
+    }
+    if (peek( ) == 'e' || peek( ) == 'E') {
+      ++pos;
+      if (peek( ) == '+' || peek( ) == '-') {
+        ++pos;
+      }
+      digits( );
+    }
+    return to_json_number(std::strtod(text.substr(start, pos - start).c_str( ), nullptr));
+  }
+
+  long integer_literal( )
+  {
+    const auto negative = accept('-');
+    skip_whitespace( );
+    const auto start = pos;
+    digits( );
+    if (start == pos || peek( ) == '.' || peek( ) == 'e' || peek( ) == 'E') {
+      throw unsupported{ };
+    }
+    const auto index = std::stol(text.substr(start, pos - start));
+    return negative ? -index : index;
+  }
+
+  // Parses the inside of [...] following a term
+  node_t bracket_suffix( )
+  {
+    skip_whitespace( );
+    auto node = peek( ) == '"' ? make_field(string_literal( ).get<std::string>( )) : make_index(integer_literal( ));
+    expect(']');
+    return node;
+  }
+
+  node_t postfix( )
+  {
+    auto node = term( );
+    while (true) {
+      skip_whitespace( );
+      if (peek( ) == '.' && is_ident_start(peek(1))) {
+        ++pos;
+        node = make_pipe(std::move(node), make_field(identifier( )));
+      } else if (peek( ) == '.' && peek(1) == '"') {
+        ++pos;
+        node = make_pipe(std::move(node), make_field(string_literal( ).get<std::string>( )));
+      } else if (peek( ) == '[') {
+        ++pos;
+        node = make_pipe(std::move(node), bracket_suffix( ));
+      } else {
+        return node;
+      }
+    }
+  }
+
+  node_t term( )
+  {
+    skip_whitespace( );
+    const auto c = peek( );
+
+    if (c == '.') {
+      ++pos;
+      if (is_ident_start(peek( ))) {
+        return make_field(identifier( ));
+      }
+      if (peek( ) == '"') {
+        return make_field(string_literal( ).get<std::string>( ));
+      }
+      if (peek( ) == '[') {
+        ++pos;
+        return bracket_suffix( );
+      }
+      if (peek( ) == '.') {
+        throw unsupported{ };
+      }
+      return make_identity( );
+    }
+
+    if (c == '"') {
+      return make_literal(string_literal( ));
+    }
+
+    if (std::isdigit(static_cast<unsigned char>(c))) {
+      return make_literal(number_literal( ));
+    }
+
+    if (c == '(') {
+      ++pos;
+      auto node = pipe( );
+      expect(')');
+      return node;
+    }
+
+    if (c == '[') {
+      ++pos;
+      if (accept(']')) {
+        return make_literal(json::array( ));
+      }
+      auto node = make_array(pipe( ));
+      expect(']');
+      return node;
+    }
+
+    if (c == '{') {
+      ++pos;
+      return object( );
+    }
+
+    if (is_ident_start(c)) {
+      return builtin(identifier( ));
+    }
+
+    throw unsupported{ };
+  }
+
+  node_t builtin(const std::string& name)
+  {
+    if (name == "true" || name == "false") {
+      return make_literal(json(name == "true"));
+    }
+    if (name == "null") {
+      return make_literal(nullptr);
+    }
+    if (name == "select" || name == "contains") {
+      expect('(');
+      auto argument = pipe( );
+      expect(')');
+      return name == "select" ? make_select(std::move(argument)) : make_contains(std::move(argument));
+    }
+    if (name == "not") {
+      return make_not( );
+    }
+    if (name == "empty") {
+      return make_empty( );
+    }
+    if (name == "length") {
+      return make_length( );
+    }
+    if (name == "arrays") {
+      return make_type_filter([](const json& v) { return v.is_array( ); });
+    }
+    if (name == "objects") {
+      return make_type_filter([](const json& v) { return v.is_object( ); });
+    }
+    if (name == "iterables") {
+      return make_type_filter([](const json& v) { return v.is_array( ) || v.is_object( ); });
+    }
+    if (name == "scalars") {
+      return make_type_filter([](const json& v) { return !v.is_array( ) && !v.is_object( ); });
+    }
+    if (name == "booleans") {
+      return make_type_filter([](const json& v) { return v.is_boolean( ); });
+    }
+    if (name == "numbers") {
+      return make_type_filter([](const json& v) { return v.is_number( ); });
+    }
+    if (name == "strings") {
+      return make_type_filter([](const json& v) { return v.is_string( ); });
+    }
+    if (name == "nulls") {
+      return make_type_filter([](const json& v) { return v.is_null( ); });
+    }
+    if (name == "values") {
+      return make_type_filter([](const json& v) { return !v.is_null( ); });
+    }
+    throw unsupported{ };
+  }
+
+  node_t object( )
+  {
+    auto pairs = std::vector<std::pair<std::string, node_t>>{ };
+
+    if (accept('}')) {
+      return make_object(std::move(pairs));
+    }
+
+    do {
+      skip_whitespace( );
+      std::string key;
+      if (peek( ) == '"') {
+        key = string_literal( ).get<std::string>( );
+      } else if (is_ident_start(peek( ))) {
+        key = identifier( );
+      } else {
+        throw unsupported{ };
+      }
+
+      if (accept(':')) {
+        pairs.emplace_back(key, object_value( ));
+      } else {
+        pairs.emplace_back(key, make_field(key));
+      }
+    } while (accept(','));
+
+    expect('}');
+    return make_object(std::move(pairs));
+  }
+
+  // Object values may be piped but not comma separated
+  node_t object_value( )
+  {
+    auto node = postfix( );
+    while (accept('|')) {
+      node = make_pipe(std::move(node), postfix( ));
+    }
+    return node;
+  }
+
+  node_t comma( )
+  {
+    auto nodes = std::vector<node_t>{ };
+    nodes.push_back(postfix( ));
+    while (accept(',')) {
+      nodes.push_back(postfix( ));
+    }
+    return nodes.size( ) == 1 ? std::move(nodes.front( )) : make_comma(std::move(nodes));
+  }
+
+  node_t pipe( )
+  {
+    auto node = comma( );
+    if (accept('|')) {
+      node = make_pipe(std::move(node), pipe( ));
+    }
+    return node;
+  }
+
+public:
+  explicit Parser(const std::string& text)
+    : text{ text }
+  {}
+
+  node_t parse( )
+  {
+    auto node = pipe( );
+    skip_whitespace( );
+    if (pos != text.size( )) {
+      throw unsupported{ };
+    }
+    return node;
+  }
+};
+}
+
+std::optional<jq_native_filter_t>
+compile_jq_native(const std::string& script)
+{
+  try {
+    return Parser{ script }.parse( ).filter;
+  } catch (const unsupported&) {
+    return std::nullopt;
+  } catch (const std::out_of_range&) {
+    return std::nullopt;
+  }
+}
+
+nlohmann::json
+normalize_jq_numbers(const nlohmann::json& value)
+{
+  switch (value.type( )) {
+    case json::value_t::number_integer:
+    case json::value_t::number_unsigned:
+    case json::value_t::number_float:
+      return to_json_number(value.get<double>( ));
+    case json::value_t::array: {
+      auto result = json::array( );
+      for (const auto& element : value) {
+        result.push_back(normalize_jq_numbers(element));
+      }
+      return result;
+    }
+    case json::value_t::object: {
+      auto result = json::object( );
+      for (auto it = value.cbegin( ); it != value.cend( ); ++it) {
+        result[it.key( )] = normalize_jq_numbers(it.value( ));
+      }
+      return result;
+    }
+    default:
+      return value;
+  }
+}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace trawler {
+
+using jq_native_sink_t = std::function<void(const nlohmann::json&)>;
+using jq_native_filter_t = std::function<void(const nlohmann::json&, const jq_native_sink_t&)>;
+
+/*******************************************************************************
+ * jq_native_error
+ *
+ * Raised by a native filter wherever libjq would have raised an error. Just
+ * like with libjq, results emitted before the error stand.
+ ******************************************************************************/
+struct jq_native_error : public std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+/*******************************************************************************
+ * compile_jq_native
+ *
+ * Compiles a jq script into a native filter operating directly on json, or
+ * returns std::nullopt if the script uses anything outside of the supported
+ * subset:
+ *
+ *   .  .key  ."key"  .[n]  .["key"]  and chains of those
+ *   f | g   f, g   (f)
+ *   literals: numbers, strings without interpolation, true, false, null
+ *   [f]   {key: f, "key": f, key, "key"}  (object values producing at most one result)
+ *   select(f)  contains(f)  not  empty  length
+ *   arrays  objects  iterables  scalars  booleans  numbers  strings  nulls  values
+ ******************************************************************************/
+std::optional<jq_native_filter_t>
+compile_jq_native(const std::string& script);
+
+/*******************************************************************************
+ * normalize_jq_numbers
+ *
+ * jq represents every number as a double. Returns a copy of value with all
+ * numbers converted the way they would come back from libjq.
+ ******************************************************************************/
+nlohmann::json
+normalize_jq_numbers(const nlohmann::json& value);
+}
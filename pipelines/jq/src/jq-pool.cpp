@@ -0,0 +1,65 @@
+#include "jq-pool.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace trawler {
+
+JqPool::JqPool(std::string script)
+  : script{ std::move(script) }
+  , max_idle{ std::max(1U, std::thread::hardware_concurrency( )) }
+{
+  idle.push_back(compile( ));
+}
+
+JqPool::~JqPool( )
+{
+  for (auto* state : idle) {
+    jq_teardown(&state);
+  }
+}
+
+jq_state*
+JqPool::compile( ) const
+{
+  auto* state = jq_init( );
+  if (state == nullptr) {
+    throw std::runtime_error{ "Failed to initialize jq" };
+  }
+
+  jq_set_attr(state, jv_string("PROGRAM_ORIGIN"), jv_string("myprog"));
+
+  if (!jq_compile_args(state, script.c_str( ), jv_array( ))) {
+    jq_teardown(&state);
+    throw std::runtime_error{ "Failed to compile jq script" };
+  }
+  return state;
+}
+
+JqPool::handle_t
+JqPool::checkout( )
+{
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (!idle.empty( )) {
+      auto* state = idle.back( );
+      idle.pop_back( );
+      return handle_t{ state, returner{ shared_from_this( ) } };
+    }
+  }
+  return handle_t{ compile( ), returner{ shared_from_this( ) } };
+}
+
+void
+JqPool::release(jq_state* state)
+{
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (idle.size( ) < max_idle) {
+      idle.push_back(state);
+      return;
+    }
+  }
+  jq_teardown(&state);
+}
+}
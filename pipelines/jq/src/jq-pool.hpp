@@ -0,0 +1,52 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <jq.h>
+}
+
+namespace trawler {
+
+/*******************************************************************************
+ * JqPool
+ *
+ * A jq_state can only be used by one thread at a time, so instead of sharing a
+ * single interpreter every run checks out a compiled state of its own. States
+ * are compiled on demand and returned to the pool when the handle is released,
+ * so the pool grows to the number of concurrent runs and no further.
+ ******************************************************************************/
+class JqPool : public std::enable_shared_from_this<JqPool>
+{
+  struct returner
+  {
+    std::shared_ptr<JqPool> pool;
+    void operator( )(jq_state* state) const { pool->release(state); }
+  };
+
+  const std::string script;
+  const std::size_t max_idle;
+  std::mutex mutex;
+  std::vector<jq_state*> idle;
+
+  jq_state* compile( ) const;
+  void release(jq_state* state);
+
+public:
+  using handle_t = std::unique_ptr<jq_state, returner>;
+
+  // Compiles the script once up front, throws if it does not compile
+  explicit JqPool(std::string script);
+
+  JqPool(const JqPool&) = delete;
+  JqPool(JqPool&&) = delete;
+  JqPool& operator=(const JqPool&) = delete;
+  JqPool& operator=(JqPool&&) = delete;
+  ~JqPool( );
+
+  handle_t checkout( );
+};
+}
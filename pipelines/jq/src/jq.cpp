@@ -1,21 +1,13 @@
+#include "jq-native.hpp"
+#include "jq-pool.hpp"
+#include "jv-json.hpp"
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <stdexcept>
 #include <trawler/pipelines/jq/jq.hpp>
 
-extern "C"
-{
-#include <jq.h>
-}
-
 namespace trawler {
 
-std::shared_ptr<jq_state>
-make_jq_state( )
-{
-  auto deleter = [](auto* p) { jq_teardown(&p); };
-  return std::shared_ptr<jq_state>(jq_init( ), deleter);
-}
-
 std::shared_ptr<jv_parser>
 make_jv_parser(int flags)
 {
@@ -23,59 +15,114 @@ make_jv_parser(int flags)
   return std::shared_ptr<jv_parser>(jv_parser_new(flags), deleter);
 }
 
-struct jv_guard
+namespace {
+
+// Returns the payload as json if it holds exactly one json value. Anything else,
+// like a stream of several values, is left to libjq.
+std::shared_ptr<const nlohmann::json>
+native_input(const ServicePacket& input)
 {
-  jv value;
-  jv_guard(jv value)
-    : value{ std::move(value) }
-  {}
-  ~jv_guard( ) { jv_free(value); }
-  operator jv( ) { return value; }
-};
+  try {
+    return input.get_payload_view<nlohmann::json>( );
+  } catch (const nlohmann::json::exception&) {
+    return nullptr;
+  }
+}
+}
 
-std::function<rxcpp::observable<ServicePacket>(const ServicePacket&)>
-create_jq_pipeline(const std::string& script, const Logger& logger)
+jq_stage_t
+create_jq_stage(const std::string& script, const Logger& logger, EJqBackend backend)
 {
-  auto jq = trawler::make_jq_state( );
-  auto args = jv_array( );
-  jq_set_attr(jq.get( ), jv_string("PROGRAM_ORIGIN"), jv_string("myprog"));
+  // The script is always compiled by libjq, so invalid scripts fail the same way regardless of backend
+  auto pool = std::make_shared<JqPool>(script);
 
-  const auto compiled = jq_compile_args(jq.get( ), script.c_str( ), args);
-  if (!compiled) {
-    throw std::runtime_error{ "Failed to compile jq script" };
+  auto native = backend != EJqBackend::INTERPRETER ? compile_jq_native(script) : std::nullopt;
+  if (!native && backend == EJqBackend::NATIVE) {
+    throw std::runtime_error{ "Script is outside of the natively supported subset of jq: " + script };
+  }
+  if (native) {
+    logger.debug("Evaluating script natively");
   }
 
-  return [=](const ServicePacket& input) {
-    return rxcpp::observable<>::create<ServicePacket>([=](auto subscriber) {
-      auto parser = make_jv_parser(0);
-      const auto payload = input.get_payload_as<std::string>( );
-      jv_parser_set_buf(parser.get( ), payload.c_str( ), payload.size( ), 0);
+  return [=](const ServicePacket& input, const jq_emit_t& emit_packet) {
+    if (native) {
+      if (const auto json = native_input(input)) {
+        auto emit = [&](const nlohmann::json& value) {
+          if (value.is_null( )) {
+            return;
+          }
+          auto result = normalize_jq_numbers(value);
+          if (logger.should_log(Logger::ELogLevel::DEBUG)) {
+            logger.debug("Emitting " + result.dump( ));
+          }
+          emit_packet(input.with_payload({ std::move(result) }));
+        };
+
+        // An error ends the output for this input, just like it does in libjq
+        try {
+          (*native)(*json, emit);
+        } catch (const jq_native_error& e) {
+          logger.debug(e.what( ));
+        }
+        return;
+      }
+    }
+
+    // Every run gets an interpreter of its own so a jq stage may run on many threads at once
+    auto jq = pool->checkout( );
 
+    auto run = [&](jv value) {
+      jq_start(jq.get( ), value, 0);
       while (true) {
-        auto value = jv_parser_next(parser.get( ));
+        auto result = jq_next(jq.get( ));
 
-        if (!jv_is_valid(value)) {
+        if (!jv_is_valid(result)) {
+          jv_free(result);
           break;
         }
 
-        jq_start(jq.get( ), value, 0);
-        while (true) {
-          auto result = jq_next(jq.get( ));
+        if (jv_get_kind(result) == JV_KIND_NULL) {
+          jv_free(result);
+          continue;
+        }
 
-          if (!jv_is_valid(result)) {
-            break;
-          }
+        auto json = to_json(result);
+        if (logger.should_log(Logger::ELogLevel::DEBUG)) {
+          logger.debug("Emitting " + json.dump( ));
+        }
+        emit_packet(input.with_payload({ std::move(json) }));
+      }
+    };
 
-          auto dump = jv_guard{ jv_dump_string(result, 0) };
-          auto result_string = std::string{ jv_string_value(dump) };
+    // Json payloads are handed to jq structurally, strings may hold a stream of several values
+    if (const auto* json = std::get_if<nlohmann::json>(&input.get_payload( ))) {
+      run(to_jv(*json));
+    } else {
+      auto parser = make_jv_parser(0);
+      const auto payload = input.get_payload_view<std::string>( );
+      jv_parser_set_buf(parser.get( ), payload->c_str( ), payload->size( ), 0);
 
-          if (result_string != "null") {
-            logger.debug("Emitting " + result_string);
-            auto json = nlohmann::json::parse(result_string);
-            subscriber.on_next(input.with_payload({ std::move(json) }));
-          }
+      while (true) {
+        auto value = jv_parser_next(parser.get( ));
+
+        if (!jv_is_valid(value)) {
+          jv_free(value);
+          break;
         }
+
+        run(value);
       }
+    }
+  };
+}
+
+std::function<rxcpp::observable<ServicePacket>(const ServicePacket&)>
+create_jq_pipeline(const std::string& script, const Logger& logger, EJqBackend backend)
+{
+  auto stage = create_jq_stage(script, logger, backend);
+  return [=](const ServicePacket& input) {
+    return rxcpp::observable<>::create<ServicePacket>([=](auto subscriber) {
+      stage(input, [&](const ServicePacket& output) { subscriber.on_next(output); });
       subscriber.on_completed( );
     });
   };
@@ -0,0 +1,108 @@
+#include "jv-json.hpp"
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+namespace trawler {
+
+using json = nlohmann::json;
+
+jv
+to_jv(const json& node)
+{
+  switch (node.type( )) {
+    case json::value_t::boolean:
+      return jv_bool(node.get<bool>( ));
+    case json::value_t::number_integer:
+      return jv_number(static_cast<double>(node.get<json::number_integer_t>( )));
+    case json::value_t::number_unsigned:
+      return jv_number(static_cast<double>(node.get<json::number_unsigned_t>( )));
+    case json::value_t::number_float:
+      return jv_number(node.get<json::number_float_t>( ));
+    case json::value_t::string: {
+      const auto& string = node.get_ref<const json::string_t&>( );
+      return jv_string_sized(string.data( ), static_cast<int>(string.size( )));
+    }
+    case json::value_t::array: {
+      auto array = jv_array_sized(static_cast<int>(node.size( )));
+      for (const auto& element : node) {
+        array = jv_array_append(array, to_jv(element));
+      }
+      return array;
+    }
+    case json::value_t::object: {
+      auto object = jv_object( );
+      for (auto it = node.cbegin( ); it != node.cend( ); ++it) {
+        const auto& key = it.key( );
+        object = jv_object_set(object, jv_string_sized(key.data( ), static_cast<int>(key.size( ))), to_jv(it.value( )));
+      }
+      return object;
+    }
+    default:
+      return jv_null( );
+  }
+}
+
+json
+to_json_number(double number)
+{
+  // jq prints NaN as null and clamps infinities, do the same
+  if (std::isnan(number)) {
+    return nullptr;
+  }
+  number = std::fmax(std::fmin(number, DBL_MAX), -DBL_MAX);
+
+  constexpr auto integer_limit = 9.2e18;
+  if (number == std::trunc(number) && std::fabs(number) < integer_limit) {
+    return static_cast<json::number_integer_t>(number);
+  }
+  return number;
+}
+
+json
+to_json(jv value)
+{
+  auto result = json{ };
+
+  switch (jv_get_kind(value)) {
+    case JV_KIND_TRUE:
+      result = true;
+      break;
+    case JV_KIND_FALSE:
+      result = false;
+      break;
+    case JV_KIND_NUMBER:
+      result = to_json_number(jv_number_value(value));
+      break;
+    case JV_KIND_STRING: {
+      const auto length = jv_string_length_bytes(jv_copy(value));
+      result = json::string_t{ jv_string_value(value), static_cast<std::size_t>(length) };
+      break;
+    }
+    case JV_KIND_ARRAY: {
+      result = json::array( );
+      const auto length = jv_array_length(jv_copy(value));
+      for (auto i = 0; i < length; ++i) {
+        result.push_back(to_json(jv_array_get(jv_copy(value), i)));
+      }
+      break;
+    }
+    case JV_KIND_OBJECT: {
+      result = json::object( );
+      for (auto it = jv_object_iter(value); jv_object_iter_valid(value, it); it = jv_object_iter_next(value, it)) {
+        auto key = jv_object_iter_key(value, it);
+        const auto length = jv_string_length_bytes(jv_copy(key));
+        result[json::string_t{ jv_string_value(key), static_cast<std::size_t>(length) }] =
+          to_json(jv_object_iter_value(value, it));
+        jv_free(key);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  jv_free(value);
+  return result;
+}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <nlohmann/json.hpp>
+
+extern "C"
+{
+#include <jq.h>
+}
+
+namespace trawler {
+
+/*******************************************************************************
+ * to_jv
+ *
+ * Structurally converts a json document into a jv value owned by the caller.
+ ******************************************************************************/
+jv
+to_jv(const nlohmann::json& node);
+
+/*******************************************************************************
+ * to_json
+ *
+ * Structurally converts a jv value into a json document. The value is consumed.
+ * Numbers that are integral come back as json integers, mirroring what the
+ * textual round trip through jv_dump_string used to produce.
+ ******************************************************************************/
+nlohmann::json
+to_json(jv value);
+
+/*******************************************************************************
+ * to_json_number
+ *
+ * Converts a jq number (always a double) the way to_json does.
+ ******************************************************************************/
+nlohmann::json
+to_json_number(double number);
+}
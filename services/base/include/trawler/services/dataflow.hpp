@@ -0,0 +1,576 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <rxcpp/rx.hpp>
+#include <string>
+#include <trawler/services/service-packet.hpp>
+#include <utility>
+#include <vector>
+
+namespace trawler {
+
+/*******************************************************************************
+ * PacketSink
+ *
+ * Anything packets are pushed into by the dataflow runtime. Packets are passed
+ * by reference all the way down a chain of nodes, a stage only copies one when
+ * it makes a new packet.
+ ******************************************************************************/
+class PacketSink
+{
+public:
+  PacketSink( ) = default;
+  PacketSink(const PacketSink&) = delete;
+  PacketSink(PacketSink&&) = delete;
+  PacketSink& operator=(const PacketSink&) = delete;
+  PacketSink& operator=(PacketSink&&) = delete;
+  virtual ~PacketSink( ) = default;
+
+  virtual void push(const ServicePacket& packet) = 0;
+  virtual void fail(std::exception_ptr error) = 0;
+  virtual void complete( ) = 0;
+};
+
+/*******************************************************************************
+ * DataflowOutputs
+ *
+ * Fans the output of a node out to the nodes wired to it and to the rxcpp
+ * subscribers observing it. Nodes must be connected before packets flow, they
+ * are pushed to without any locking. Subscribers may come and go at any time.
+ ******************************************************************************/
+class DataflowOutputs final : public PacketSink
+{
+  using subscriber_t = rxcpp::subscriber<ServicePacket>;
+  using subscribers_t = std::map<std::size_t, subscriber_t>;
+
+  std::vector<std::shared_ptr<PacketSink>> nodes;
+  std::mutex mutex;
+  std::size_t next_id = 0;
+  std::shared_ptr<const subscribers_t> subscribers = std::make_shared<const subscribers_t>( );
+  std::atomic<bool> has_subscribers{ false };
+
+  // Subscribers are copied on write so they can be pushed to without holding the lock
+  std::shared_ptr<const subscribers_t> get_subscribers( )
+  {
+    if (!has_subscribers.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    std::lock_guard<std::mutex> lock{ mutex };
+    return subscribers;
+  }
+
+public:
+  void connect(std::shared_ptr<PacketSink> node) { nodes.push_back(std::move(node)); }
+
+  std::size_t observe(subscriber_t subscriber)
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    auto next = std::make_shared<subscribers_t>(*subscribers);
+    next->emplace(next_id, std::move(subscriber));
+    subscribers = std::move(next);
+    has_subscribers.store(true, std::memory_order_release);
+    return next_id++;
+  }
+
+  void forget(std::size_t id)
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    auto next = std::make_shared<subscribers_t>(*subscribers);
+    next->erase(id);
+    has_subscribers.store(!next->empty( ), std::memory_order_release);
+    subscribers = std::move(next);
+  }
+
+  void push(const ServicePacket& packet) override
+  {
+    for (const auto& node : nodes) {
+      node->push(packet);
+    }
+    if (const auto observers = get_subscribers( )) {
+      for (const auto& [id, subscriber] : *observers) {
+        subscriber.on_next(packet);
+      }
+    }
+  }
+
+  void fail(std::exception_ptr error) override
+  {
+    for (const auto& node : nodes) {
+      node->fail(error);
+    }
+    if (const auto observers = get_subscribers( )) {
+      for (const auto& [id, subscriber] : *observers) {
+        subscriber.on_error(error);
+      }
+    }
+  }
+
+  void complete( ) override
+  {
+    for (const auto& node : nodes) {
+      node->complete( );
+    }
+    if (const auto observers = get_subscribers( )) {
+      for (const auto& [id, subscriber] : *observers) {
+        subscriber.on_completed( );
+      }
+    }
+  }
+};
+
+/*******************************************************************************
+ * DataflowNode
+ *
+ * A stage of the dataflow graph, typed on the stage itself so the stage is
+ * called directly. A stage is called as stage(packet, outputs) and pushes its
+ * results, if any, into outputs. A stage throwing fails everything downstream
+ * of the node, which then drops all further packets.
+ ******************************************************************************/
+template<typename Stage>
+class DataflowNode final : public PacketSink
+{
+  Stage stage;
+  std::shared_ptr<DataflowOutputs> outputs = std::make_shared<DataflowOutputs>( );
+  std::atomic<bool> failed{ false };
+
+public:
+  explicit DataflowNode(Stage stage)
+    : stage{ std::move(stage) }
+  {}
+
+  const std::shared_ptr<DataflowOutputs>& get_outputs( ) const { return outputs; }
+
+  void push(const ServicePacket& packet) override
+  {
+    if (failed.load(std::memory_order_relaxed)) {
+      return;
+    }
+    try {
+      stage(packet, static_cast<PacketSink&>(*outputs));
+    } catch (...) {
+      fail(std::current_exception( ));
+    }
+  }
+
+  void fail(std::exception_ptr error) override
+  {
+    if (!failed.exchange(true)) {
+      outputs->fail(error);
+    }
+  }
+
+  void complete( ) override { outputs->complete( ); }
+};
+
+template<typename Stage>
+auto
+make_dataflow_node(Stage stage)
+{
+  return std::make_shared<DataflowNode<Stage>>(std::move(stage));
+}
+
+/*******************************************************************************
+ * ParallelNode
+ *
+ * A stage of the dataflow graph run for up to `parallelism` packets at once on
+ * the threads of an io_context. Every packet gets a Slot the stage emits its
+ * results through and finishes once it is done with the packet, which it may
+ * do from any thread. Ordered, results are released in the order of the input
+ * packets through a reorder buffer, otherwise as soon as they are emitted.
+ * Completion is passed on once every packet has been finished. Whatever the
+ * thread the stage runs on, the nodes downstream are pushed to by one thread
+ * at a time and never while the node holds its lock.
+ *
+ * Partitioned, every packet is assigned to one of `parallelism` lanes by the
+ * hash the partition returns for it. A lane runs one packet at a time, so the
+ * packets sharing a key run one after the other in the order they came in
+ * while packets of different lanes run concurrently.
+ ******************************************************************************/
+class ParallelNode final
+  : public PacketSink
+  , public std::enable_shared_from_this<ParallelNode>
+{
+public:
+  class Slot
+  {
+    std::shared_ptr<ParallelNode> node;
+    std::size_t sequence;
+    std::size_t lane;
+
+  public:
+    Slot(std::shared_ptr<ParallelNode> node, std::size_t sequence, std::size_t lane)
+      : node{ std::move(node) }
+      , sequence{ sequence }
+      , lane{ lane }
+    {}
+
+    void emit(const ServicePacket& packet) const { node->emit(sequence, packet); }
+    void fail(std::exception_ptr error) const { node->fail(error); }
+    void finish( ) const { node->finish(sequence, lane); }
+  };
+
+  using task_t = std::function<void(const ServicePacket&, const Slot&)>;
+  using partition_t = std::function<std::size_t(const ServicePacket&)>;
+
+private:
+  struct pending_t
+  {
+    std::vector<ServicePacket> results;
+    bool finished = false;
+  };
+
+  using job_t = std::pair<std::size_t, ServicePacket>;
+
+  struct lane_t
+  {
+    bool is_running = false;
+    std::deque<job_t> waiting;
+  };
+
+  boost::asio::io_context& context;
+  const std::size_t parallelism;
+  const bool ordered;
+  const task_t task;
+  const partition_t partition;
+  std::shared_ptr<DataflowOutputs> outputs = std::make_shared<DataflowOutputs>( );
+  std::atomic<bool> failed{ false };
+
+  std::mutex mutex;
+  std::size_t nof_running = 0;
+  std::deque<job_t> waiting;
+  // Partitioned only, the packets waiting for their lane instead of for any worker
+  std::vector<lane_t> lanes;
+  std::size_t next_sequence = 0;
+  bool completed = false;
+  // Ordered only, every packet not yet released keyed on its sequence number, the first one is being released
+  std::map<std::size_t, pending_t> reorder_buffer;
+  // What is to be passed downstream next, in order, by the thread delivering
+  std::vector<ServicePacket> outbox;
+  std::exception_ptr pending_error;
+  bool pending_complete = false;
+  bool is_delivering = false;
+
+  void start(std::size_t sequence, std::size_t lane, ServicePacket packet)
+  {
+    boost::asio::post(context, [self = shared_from_this( ), sequence, lane, packet = std::move(packet)] {
+      self->task(packet, Slot{ self, sequence, lane });
+    });
+  }
+
+  // Passes on the outbox until it stays empty, unless another thread is at it already. Called with the lock held,
+  // which is let go of while pushing downstream
+  void deliver(std::unique_lock<std::mutex>& lock)
+  {
+    if (is_delivering) {
+      return;
+    }
+    is_delivering = true;
+    while (!outbox.empty( ) || pending_error || pending_complete) {
+      auto packets = std::vector<ServicePacket>{ };
+      packets.swap(outbox);
+      const auto error = std::exchange(pending_error, nullptr);
+      const auto is_complete = std::exchange(pending_complete, false);
+      lock.unlock( );
+      for (const auto& packet : packets) {
+        outputs->push(packet);
+      }
+      if (error) {
+        outputs->fail(error);
+      }
+      if (is_complete) {
+        outputs->complete( );
+      }
+      lock.lock( );
+    }
+    is_delivering = false;
+  }
+
+  void emit(std::size_t sequence, const ServicePacket& packet)
+  {
+    if (failed.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    // Results of the packet being released go out right away, the others wait for their turn
+    std::unique_lock<std::mutex> lock{ mutex };
+    if (!ordered || sequence == reorder_buffer.begin( )->first) {
+      outbox.push_back(packet);
+      deliver(lock);
+    } else {
+      reorder_buffer[sequence].results.push_back(packet);
+    }
+  }
+
+  void release_finished( )
+  {
+    while (!reorder_buffer.empty( ) && reorder_buffer.begin( )->second.finished) {
+      reorder_buffer.erase(reorder_buffer.begin( ));
+      if (reorder_buffer.empty( )) {
+        break;
+      }
+      auto& next = reorder_buffer.begin( )->second;
+      std::move(begin(next.results), end(next.results), std::back_inserter(outbox));
+      next.results.clear( );
+    }
+  }
+
+  void finish(std::size_t sequence, std::size_t lane)
+  {
+    auto next = std::optional<job_t>{ };
+    {
+      std::unique_lock<std::mutex> lock{ mutex };
+      if (ordered) {
+        reorder_buffer[sequence].finished = true;
+        if (!failed.load(std::memory_order_relaxed)) {
+          release_finished( );
+        }
+      }
+      auto& queue = partition ? lanes[lane].waiting : waiting;
+      if (!queue.empty( ) && !failed.load(std::memory_order_relaxed)) {
+        next = std::move(queue.front( ));
+        queue.pop_front( );
+      } else {
+        if (partition) {
+          lanes[lane].is_running = false;
+        }
+        --nof_running;
+        pending_complete = pending_complete || (completed && nof_running == 0);
+      }
+      deliver(lock);
+    }
+
+    if (next) {
+      start(next->first, lane, std::move(next->second));
+    }
+  }
+
+public:
+  ParallelNode(boost::asio::io_context& context,
+               std::size_t parallelism,
+               bool ordered,
+               task_t task,
+               partition_t partition = nullptr)
+    : context{ context }
+    , parallelism{ parallelism }
+    , ordered{ ordered }
+    , task{ std::move(task) }
+    , partition{ std::move(partition) }
+    , lanes(this->partition ? parallelism : 0)
+  {}
+
+  const std::shared_ptr<DataflowOutputs>& get_outputs( ) const { return outputs; }
+
+  void push(const ServicePacket& packet) override
+  {
+    if (failed.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    const auto lane = partition ? partition(packet) % parallelism : 0;
+    auto sequence = std::size_t{ 0 };
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      sequence = next_sequence++;
+      if (ordered) {
+        reorder_buffer.emplace(sequence, pending_t{ });
+      }
+      if (partition) {
+        if (lanes[lane].is_running) {
+          lanes[lane].waiting.emplace_back(sequence, packet);
+          return;
+        }
+        lanes[lane].is_running = true;
+      } else if (nof_running == parallelism) {
+        waiting.emplace_back(sequence, packet);
+        return;
+      }
+      ++nof_running;
+    }
+    start(sequence, lane, packet);
+  }
+
+  void fail(std::exception_ptr error) override
+  {
+    if (!failed.exchange(true)) {
+      std::unique_lock<std::mutex> lock{ mutex };
+      pending_error = error;
+      deliver(lock);
+    }
+  }
+
+  void complete( ) override
+  {
+    std::unique_lock<std::mutex> lock{ mutex };
+    completed = true;
+    pending_complete = pending_complete || nof_running == 0;
+    deliver(lock);
+  }
+};
+
+/*******************************************************************************
+ * make_json_partition
+ *
+ * Partitions a ParallelNode on the value the JSON pointer refers to in the
+ * payload of a packet. Packets without one, or without a json payload, share
+ * the first lane. An empty pointer doesn't partition at all.
+ ******************************************************************************/
+inline ParallelNode::partition_t
+make_json_partition(const std::string& pointer)
+{
+  if (pointer.empty( )) {
+    return nullptr;
+  }
+  return [pointer = nlohmann::json::json_pointer{ pointer }](const ServicePacket& packet) -> std::size_t {
+    try {
+      const auto key = packet.get_payload_view<nlohmann::json>( )->value(pointer, nlohmann::json{ });
+      return key.is_null( ) ? 0 : std::hash<std::string>{ }(key.dump( ));
+    } catch (const nlohmann::json::exception&) {
+      return 0;
+    }
+  };
+}
+
+/*******************************************************************************
+ * make_parallel_task
+ *
+ * Runs a stage called as stage(packet, outputs), just like the stage of a
+ * DataflowNode, on a ParallelNode.
+ ******************************************************************************/
+template<typename Stage>
+ParallelNode::task_t
+make_parallel_task(Stage stage)
+{
+  class SlotSink final : public PacketSink
+  {
+    const ParallelNode::Slot& slot;
+
+  public:
+    explicit SlotSink(const ParallelNode::Slot& slot)
+      : slot{ slot }
+    {}
+
+    void push(const ServicePacket& packet) override { slot.emit(packet); }
+    void fail(std::exception_ptr error) override { slot.fail(error); }
+    void complete( ) override {}
+  };
+
+  return [stage = std::move(stage)](const ServicePacket& packet, const ParallelNode::Slot& slot) {
+    auto sink = SlotSink{ slot };
+    try {
+      stage(packet, static_cast<PacketSink&>(sink));
+    } catch (...) {
+      slot.fail(std::current_exception( ));
+    }
+    slot.finish( );
+  };
+}
+
+/*******************************************************************************
+ * make_observable_task
+ *
+ * Runs a stage returning an observable of its results for every packet, like
+ * the http-client, on a ParallelNode. A packet is finished once its observable
+ * completes, which may well be on another thread.
+ ******************************************************************************/
+template<typename Transform>
+ParallelNode::task_t
+make_observable_task(Transform transform)
+{
+  return [transform = std::move(transform)](const ServicePacket& packet, const ParallelNode::Slot& slot) {
+    transform(packet).subscribe([slot](const ServicePacket& result) { slot.emit(result); },
+                                [slot](std::exception_ptr error) {
+                                  slot.fail(error);
+                                  slot.finish( );
+                                },
+                                [slot]( ) { slot.finish( ); });
+  };
+}
+
+/*******************************************************************************
+ * DataflowSource
+ *
+ * Where a dataflow graph is fed by an rxcpp observable. The observable is
+ * subscribed to once, when the first subscriber anywhere in the graph shows
+ * up, and unsubscribed from when the last one leaves.
+ ******************************************************************************/
+class DataflowSource
+{
+  rxcpp::observable<ServicePacket> upstream;
+  std::shared_ptr<DataflowOutputs> outputs = std::make_shared<DataflowOutputs>( );
+  std::mutex mutex;
+  std::size_t nof_subscribers = 0;
+  rxcpp::composite_subscription lifetime;
+
+public:
+  explicit DataflowSource(rxcpp::observable<ServicePacket> upstream)
+    : upstream{ std::move(upstream) }
+  {}
+
+  const std::shared_ptr<DataflowOutputs>& get_outputs( ) const { return outputs; }
+
+  void retain( )
+  {
+    auto subscription = rxcpp::composite_subscription{ };
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      if (nof_subscribers++ > 0) {
+        return;
+      }
+      lifetime = subscription;
+    }
+
+    // Subscribed outside of the lock, the upstream may well complete right away
+    auto sink = outputs;
+    upstream.subscribe(
+      subscription,
+      [sink](const ServicePacket& packet) { sink->push(packet); },
+      [sink](std::exception_ptr error) { sink->fail(error); },
+      [sink]( ) { sink->complete( ); });
+  }
+
+  void release( )
+  {
+    auto subscription = rxcpp::composite_subscription{ };
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      if (--nof_subscribers > 0) {
+        return;
+      }
+      subscription = lifetime;
+    }
+    subscription.unsubscribe( );
+  }
+};
+
+/*******************************************************************************
+ * make_dataflow_observable
+ *
+ * The output of a node in the graph fed by source, as an observable for the
+ * rxcpp world at the edges of the graph.
+ ******************************************************************************/
+inline rxcpp::observable<ServicePacket>
+make_dataflow_observable(std::shared_ptr<DataflowSource> source, std::shared_ptr<DataflowOutputs> outputs)
+{
+  return rxcpp::observable<>::create<ServicePacket>([=](rxcpp::subscriber<ServicePacket> subscriber) {
+    // Retained before the release is added, which runs right away for a subscriber already unsubscribed
+    const auto id = outputs->observe(subscriber);
+    source->retain( );
+    subscriber.add([=] {
+      outputs->forget(id);
+      source->release( );
+    });
+  });
+}
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace trawler {
+
+/*******************************************************************************
+ * ResolverCache
+ *
+ * Asynchronous name resolution shared by all outbound connections. Successful
+ * lookups are kept for `positive_ttl` and failed ones for `negative_ttl`, and
+ * concurrent lookups of the same name are folded into one. Handlers are always
+ * invoked through the io_context, never from within async_resolve.
+ ******************************************************************************/
+class ResolverCache
+{
+public:
+  using clock_t = std::chrono::steady_clock;
+  using error_t = boost::system::error_code;
+  using results_t = boost::asio::ip::tcp::resolver::results_type;
+  using handler_t = std::function<void(error_t, results_t)>;
+
+private:
+  using key_t = std::pair<std::string, std::string>;
+
+  struct entry_t
+  {
+    error_t ec;
+    results_t results;
+    clock_t::time_point expires;
+  };
+
+  boost::asio::io_context& context;
+  std::mutex mutex;
+  clock_t::duration positive_ttl;
+  clock_t::duration negative_ttl;
+  std::map<key_t, entry_t> entries;
+  std::map<key_t, std::vector<handler_t>> in_flight;
+  std::size_t nof_lookups = 0;
+
+  void on_resolve(const key_t& key, error_t ec, results_t results)
+  {
+    auto handlers = std::vector<handler_t>{ };
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      const auto ttl = ec ? negative_ttl : positive_ttl;
+      entries[key] = entry_t{ ec, results, clock_t::now( ) + ttl };
+      handlers = std::move(in_flight[key]);
+      in_flight.erase(key);
+    }
+    for (auto& handler : handlers) {
+      handler(ec, results);
+    }
+  }
+
+public:
+  explicit ResolverCache(boost::asio::io_context& context,
+                         clock_t::duration positive_ttl = std::chrono::seconds{ 60 },
+                         clock_t::duration negative_ttl = std::chrono::seconds{ 5 })
+    : context{ context }
+    , positive_ttl{ positive_ttl }
+    , negative_ttl{ negative_ttl }
+  {}
+
+  ResolverCache(const ResolverCache&) = delete;
+  ResolverCache(ResolverCache&&) = delete;
+  ResolverCache& operator=(const ResolverCache&) = delete;
+  ResolverCache& operator=(ResolverCache&&) = delete;
+  ~ResolverCache( ) = default;
+
+  void set_ttl(clock_t::duration positive, clock_t::duration negative)
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    positive_ttl = positive;
+    negative_ttl = negative;
+  }
+
+  void async_resolve(const std::string& host, const std::string& port, handler_t handler)
+  {
+    auto key = key_t{ host, port };
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+
+      const auto entry = entries.find(key);
+      if (entry != end(entries)) {
+        if (clock_t::now( ) < entry->second.expires) {
+          boost::asio::post(context, [handler, ec = entry->second.ec, results = entry->second.results] {
+            handler(ec, results);
+          });
+          return;
+        }
+        entries.erase(entry);
+      }
+
+      auto& waiting = in_flight[key];
+      waiting.push_back(std::move(handler));
+      if (waiting.size( ) > 1) {
+        return;
+      }
+      ++nof_lookups;
+    }
+
+    auto resolver = std::make_shared<boost::asio::ip::tcp::resolver>(context);
+    resolver->async_resolve(host, port, [this, resolver, key](error_t ec, results_t results) {
+      on_resolve(key, ec, std::move(results));
+    });
+  }
+
+  // The number of lookups that actually went to the system resolver
+  std::size_t lookups( )
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    return nof_lookups;
+  }
+};
+}
@@ -1,16 +1,42 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <boost/asio/executor_work_guard.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <memory>
 #include <thread>
+#include <trawler/services/resolver-cache.hpp>
 #include <vector>
 
 namespace trawler {
+
+/*******************************************************************************
+ * ESessionThreading
+ *
+ * SHARED runs all session threads on one io_context, any of them may run the
+ * handlers of any connection. SHARDED gives each session thread an io_context
+ * of its own and assigns every accepted connection to one of them, so the
+ * sessions of a connection never move between threads.
+ ******************************************************************************/
+enum class ESessionThreading
+{
+  SHARED,
+  SHARDED
+};
+
 class ServiceContext
 {
 
+  // Exposes shutdown( ), which destroys pending handlers without destroying the context itself
+  struct io_context_t : public boost::asio::io_context
+  {
+    using boost::asio::io_context::shutdown;
+  };
+
   struct context_instance
   {
-    boost::asio::io_context context;
+    io_context_t context;
     boost::asio::executor_work_guard<boost::asio::io_context::executor_type> guard;
     std::vector<std::thread> threads;
 
@@ -22,7 +48,9 @@ class ServiceContext
       }
     }
 
-    ~context_instance( )
+    ~context_instance( ) { stop( ); }
+
+    void stop( )
     {
       guard.reset( );
       context.stop( );
@@ -39,28 +67,122 @@ class ServiceContext
     context_instance& operator=(context_instance&&) = delete;
   };
 
-  context_instance session_context;
+  static std::vector<std::unique_ptr<context_instance>> make_session_shards(std::size_t nof_threads,
+                                                                            ESessionThreading threading)
+  {
+    auto shards = std::vector<std::unique_ptr<context_instance>>{ };
+    if (threading == ESessionThreading::SHARED) {
+      shards.push_back(std::make_unique<context_instance>(nof_threads));
+      return shards;
+    }
+    for (auto i = 0U; i < std::max(nof_threads, std::size_t{ 1 }); ++i) {
+      shards.push_back(std::make_unique<context_instance>(1));
+    }
+    return shards;
+  }
+
+  // The first shard is the session context of everything not tied to an accepted connection
+  std::vector<std::unique_ptr<context_instance>> session_shards;
+  std::atomic<std::size_t> next_session_shard{ 0 };
   context_instance service_context;
+  ResolverCache resolver_cache;
 
 public:
-  ServiceContext(std::size_t nof_session_threads, std::size_t nof_service_threads)
-    : session_context{ nof_session_threads }
+  ServiceContext(std::size_t nof_session_threads,
+                 std::size_t nof_service_threads,
+                 ESessionThreading threading = ESessionThreading::SHARED)
+    : session_shards{ make_session_shards(nof_session_threads, threading) }
     , service_context{ nof_service_threads }
+    , resolver_cache{ session_shards.front( )->context }
   {}
 
   ServiceContext(const ServiceContext&) = delete;
   ServiceContext(ServiceContext&&) = delete;
   ServiceContext& operator=(const ServiceContext&) = delete;
   ServiceContext& operator=(ServiceContext&&) = delete;
-  ~ServiceContext( ) = default;
+  // Stop the threads before the resolver cache, which their handlers refer to, goes away. Pending handlers of
+  // either context may hold objects of the other one (sockets, strands), so all of them are destroyed before any
+  // of the contexts is.
+  ~ServiceContext( )
+  {
+    for (auto& shard : session_shards) {
+      shard->stop( );
+    }
+    service_context.stop( );
+    for (auto& shard : session_shards) {
+      shard->context.shutdown( );
+    }
+    service_context.context.shutdown( );
+  }
+
+  boost::asio::io_context& get_session_context( ) { return session_shards.front( )->context; }
+
+  // The session context for a newly accepted connection, taking turns between the shards
+  boost::asio::io_context& get_session_shard( )
+  {
+    const auto index = next_session_shard.fetch_add(1, std::memory_order_relaxed) % session_shards.size( );
+    return session_shards[index]->context;
+  }
+
+  std::size_t get_nof_session_shards( ) const { return session_shards.size( ); }
+
+  std::size_t get_nof_session_threads( ) const
+  {
+    auto nof_threads = std::size_t{ 0 };
+    for (const auto& shard : session_shards) {
+      nof_threads += shard->threads.size( );
+    }
+    return nof_threads;
+  }
 
-  boost::asio::io_context& get_session_context( ) { return session_context.context; }
   boost::asio::io_context& get_service_context( ) { return service_context.context; }
+  ResolverCache& get_resolver_cache( ) { return resolver_cache; }
 };
 
 inline std::shared_ptr<ServiceContext>
-make_service_context(std::size_t nof_session_threads = 1, std::size_t nof_service_threads = 1)
+make_service_context(std::size_t nof_session_threads = 1,
+                     std::size_t nof_service_threads = 1,
+                     ESessionThreading threading = ESessionThreading::SHARED)
+{
+  return std::make_shared<ServiceContext>(nof_session_threads, nof_service_threads, threading);
+}
+
+/*******************************************************************************
+ * get_io_context
+ *
+ * Returns the io_context an I/O object was created on, which for accepted
+ * connections is the session shard they were assigned to.
+ ******************************************************************************/
+template<typename IoObject>
+boost::asio::io_context&
+get_io_context(IoObject& object)
+{
+  // An io_context already before Boost 1.74, the execution_context of the polymorphic executor since
+  return static_cast<boost::asio::io_context&>(object.get_executor( ).context( ));
+}
+
+/*******************************************************************************
+ * make_service_strand
+ *
+ * Returns a strand on the service context which keeps the context alive, so
+ * it is never destroyed after the context no matter in which order the
+ * objects holding both are torn down. Handlers should capture a copy of the
+ * strand rather than the pointer, or they may end up releasing the context on
+ * one of its own threads.
+ ******************************************************************************/
+inline std::shared_ptr<boost::asio::strand<boost::asio::io_context::executor_type>>
+make_service_strand(const std::shared_ptr<ServiceContext>& context)
 {
-  return std::make_shared<ServiceContext>(nof_session_threads, nof_service_threads);
+  using strand_t = boost::asio::strand<boost::asio::io_context::executor_type>;
+
+  struct holder_t
+  {
+    std::shared_ptr<ServiceContext> context;
+    strand_t strand;
+  };
+
+  auto strand = strand_t{ context->get_service_context( ).get_executor( ) };
+  auto holder = std::make_shared<holder_t>(holder_t{ context, std::move(strand) });
+  return { holder, &holder->strand };
 }
 }
@@ -1,6 +1,12 @@
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
 #include <variant>
 
 namespace trawler {
@@ -15,74 +21,218 @@ public:
     DATA_TRANSMISSION
   };
   using payload_t = std::variant<std::monostate, std::string, nlohmann::json>;
-  using on_reply_t = std::function<void(std::string)>;
+
+  /*****************************************************************************
+   * Payload
+   *
+   * An immutable payload that lazily memoizes its other representation, so a
+   * string payload is parsed at most once and a json payload is dumped at most
+   * once no matter how many stages (on how many threads) ask for it.
+   ****************************************************************************/
+  class Payload
+  {
+    payload_t value;
+    mutable std::mutex mutex;
+    mutable std::atomic<bool> has_text{ false };
+    mutable std::atomic<bool> has_json{ false };
+    mutable std::optional<std::string> text;
+    mutable std::optional<nlohmann::json> json;
+
+    template<typename Make>
+    void memoize(std::atomic<bool>& flag, Make make) const
+    {
+      if (!flag.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock{ mutex };
+        if (!flag.load(std::memory_order_relaxed)) {
+          make( );
+          flag.store(true, std::memory_order_release);
+        }
+      }
+    }
+
+  public:
+    explicit Payload(payload_t value)
+      : value{ std::move(value) }
+    {}
+
+    Payload(const Payload&) = delete;
+    Payload(Payload&&) = delete;
+    Payload& operator=(const Payload&) = delete;
+    Payload& operator=(Payload&&) = delete;
+    ~Payload( ) = default;
+
+    const payload_t& get( ) const { return value; }
+
+    const std::string& as_string( ) const
+    {
+      if (const auto* string = std::get_if<std::string>(&value)) {
+        return *string;
+      }
+      memoize(has_text, [this] {
+        const auto* dom = std::get_if<nlohmann::json>(&value);
+        text.emplace(dom ? dom->dump( ) : std::string{ });
+      });
+      return *text;
+    }
+
+    const nlohmann::json& as_json( ) const
+    {
+      if (const auto* dom = std::get_if<nlohmann::json>(&value)) {
+        return *dom;
+      }
+      memoize(has_json, [this] {
+        const auto* string = std::get_if<std::string>(&value);
+        json.emplace(string ? nlohmann::json::parse(*string) : nlohmann::json{ });
+      });
+      return *json;
+    }
+  };
+
+  using shared_payload_t = std::shared_ptr<const Payload>;
+  using reply_t = std::shared_ptr<const std::string>;
+  using on_reply_t = std::function<void(reply_t)>;
+  using shared_on_reply_t = std::shared_ptr<const on_reply_t>;
+  using clock_t = std::chrono::steady_clock;
+
+  /*****************************************************************************
+   * Deadline
+   *
+   * When whoever is waiting for the outcome of a packet gives up on it, and
+   * how to tell them the packet was dropped because of that.
+   ****************************************************************************/
+  struct Deadline
+  {
+    clock_t::time_point at;
+    std::function<void( )> on_expired;
+
+    bool has_passed( ) const { return clock_t::now( ) >= at; }
+  };
+
+  using shared_deadline_t = std::shared_ptr<const Deadline>;
 
 private:
+  // Payloads are immutable once wrapped in a packet, which lets every copy of
+  // the packet (fan-out, with_payload, replies) share the same allocation.
   EStatus status;
-  payload_t payload;
-  on_reply_t on_reply;
+  shared_payload_t payload;
+  shared_on_reply_t on_reply;
+  shared_deadline_t deadline;
+
+  static const shared_payload_t& empty_payload( )
+  {
+    static const auto empty = make_payload({ });
+    return empty;
+  }
+
+  ServicePacket(EStatus status, shared_payload_t payload, shared_on_reply_t on_reply, shared_deadline_t deadline)
+    : status{ status }
+    , payload{ payload ? std::move(payload) : empty_payload( ) }
+    , on_reply{ std::move(on_reply) }
+    , deadline{ std::move(deadline) }
+  {}
 
 public:
-  bool reply(std::string reply_payload) const
+  static shared_payload_t make_payload(payload_t payload)
+  {
+    return std::make_shared<const Payload>(std::move(payload));
+  }
+
+  static shared_on_reply_t make_on_reply(on_reply_t on_reply)
+  {
+    return std::make_shared<const on_reply_t>(std::move(on_reply));
+  }
+
+  static shared_deadline_t make_deadline(clock_t::time_point at, std::function<void( )> on_expired = nullptr)
+  {
+    return std::make_shared<const Deadline>(Deadline{ at, std::move(on_expired) });
+  }
+
+  bool reply(reply_t reply_payload) const
   {
-    if (on_reply) {
-      on_reply(std::move(reply_payload));
+    if (on_reply && *on_reply) {
+      (*on_reply)(std::move(reply_payload));
       return true;
     }
     return false;
   }
 
+  bool reply(std::string reply_payload) const
+  {
+    return reply(std::make_shared<const std::string>(std::move(reply_payload)));
+  }
+
+  // Returns a reference counted view of the payload converted to T. The view
+  // aliases the shared payload, conversions are memoized by the payload.
   template<typename T>
-  T get_payload_as( ) const;
+  std::shared_ptr<const T> get_payload_view( ) const;
 
-  const payload_t& get_payload( ) const { return payload; }
+  template<typename T>
+  T get_payload_as( ) const
+  {
+    return *get_payload_view<T>( );
+  }
+
+  const payload_t& get_payload( ) const { return payload->get( ); }
+
+  const shared_payload_t& get_shared_payload( ) const { return payload; }
 
   EStatus get_status( ) const { return status; }
 
+  const shared_deadline_t& get_deadline( ) const { return deadline; }
+
+  bool is_expired( ) const { return deadline && deadline->has_passed( ); }
+
+  // Gives up on a packet past its deadline, telling whoever is waiting for it
+  void expire( ) const
+  {
+    if (deadline && deadline->on_expired) {
+      deadline->on_expired( );
+    }
+  }
+
   explicit ServicePacket(EStatus status)
-    : status{ status }
+    : ServicePacket{ status, empty_payload( ), nullptr, nullptr }
   {}
 
   ServicePacket(EStatus status, payload_t payload)
-    : status{ status }
-    , payload{ std::move(payload) }
+    : ServicePacket{ status, make_payload(std::move(payload)), nullptr, nullptr }
   {}
 
   ServicePacket(EStatus status, payload_t payload, on_reply_t on_reply)
-    : status{ status }
-    , payload{ std::move(payload) }
-    , on_reply{ std::move(on_reply) }
+    : ServicePacket{ status, make_payload(std::move(payload)), make_on_reply(std::move(on_reply)), nullptr }
+  {}
+
+  ServicePacket(EStatus status, payload_t payload, shared_on_reply_t on_reply)
+    : ServicePacket{ status, make_payload(std::move(payload)), std::move(on_reply), nullptr }
   {}
 
   ServicePacket with_payload(payload_t payload) const
   {
-    return ServicePacket{ this->status, std::move(payload), this->on_reply };
+    return ServicePacket{ this->status, make_payload(std::move(payload)), this->on_reply, this->deadline };
+  }
+
+  ServicePacket with_shared_payload(shared_payload_t payload) const
+  {
+    return ServicePacket{ this->status, std::move(payload), this->on_reply, this->deadline };
+  }
+
+  ServicePacket with_deadline(shared_deadline_t deadline) const
+  {
+    return ServicePacket{ this->status, this->payload, this->on_reply, std::move(deadline) };
   }
 };
 
 template<>
-inline std::string
-ServicePacket::get_payload_as<std::string>( ) const
+inline std::shared_ptr<const std::string>
+ServicePacket::get_payload_view<std::string>( ) const
 {
-  if (std::holds_alternative<std::string>(payload)) {
-    return std::get<std::string>(payload);
-  }
-  if (std::holds_alternative<nlohmann::json>(payload)) {
-    return std::get<nlohmann::json>(payload).dump( );
-  }
-  return "";
+  return { payload, &payload->as_string( ) };
 }
 
 template<>
-inline nlohmann::json
-ServicePacket::get_payload_as<nlohmann::json>( ) const
+inline std::shared_ptr<const nlohmann::json>
+ServicePacket::get_payload_view<nlohmann::json>( ) const
 {
-  if (std::holds_alternative<std::string>(payload)) {
-    return nlohmann::json::parse(std::get<std::string>(payload));
-  }
-  if (std::holds_alternative<nlohmann::json>(payload)) {
-    return std::get<nlohmann::json>(payload);
-  }
-  return nlohmann::json{};
+  return { payload, &payload->as_json( ) };
 }
 }
@@ -1,13 +1,37 @@
 #pragma once
+#include <chrono>
+#include <cstddef>
 #include <rxcpp/rx.hpp>
 #include <trawler/logging/logger.hpp>
 #include <trawler/services/service-context.hpp>
 #include <trawler/services/service-packet.hpp>
 
 namespace trawler {
+
+struct http_server_options_t
+{
+  // Requests carry a deadline this far in the future, 0 means no deadline.
+  // Clients may pick a shorter one with an X-Request-Timeout header (milliseconds), at most an hour without a
+  // deadline of the server. Requests dropped by a stage for being past their deadline are answered 504
+  std::chrono::milliseconds timeout{ 0 };
+
+  // Listening sockets sharing the port through SO_REUSEPORT, each one accepting on a thread of its own.
+  // 0 uses one per session thread
+  std::size_t acceptors = 1;
+
+  // Bind with SO_REUSEPORT even with a single acceptor, so other processes may listen on the same port
+  bool reuse_port = false;
+
+  // Run the pipelines of a request on the session thread that read it and write the reply from there, without
+  // going through the service strand shared by the connections. Replies made on another thread, after an
+  // asynchronous stage, are handed back to the session strand
+  bool run_to_completion = false;
+};
+
 rxcpp::observable<ServicePacket>
 create_http_server(const std::shared_ptr<ServiceContext>& context,
                    const std::string& host,
                    unsigned short port,
+                   const http_server_options_t& options = { },
                    const Logger& logger = { "http-server" });
 }
@@ -1,8 +1,13 @@
+#include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/asio/bind_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <chrono>
 #include <nlohmann/json.hpp>
 #include <trawler/services/http-server/http-server.hpp>
 #include <trawler/services/tcp-common/make-tcp-acceptor.hpp>
@@ -10,9 +15,43 @@
 
 namespace trawler {
 
+namespace {
+// What a response needs to know about the request it answers
+struct response_info_t
+{
+  unsigned version = 11;
+  bool keep_alive = true;
+};
+
+// The longest deadline a client may ask for when the server doesn't set one
+constexpr auto max_request_timeout = std::chrono::milliseconds{ std::chrono::hours{ 1 } };
+
+// The deadline a client asks for in the X-Request-Timeout header, or the default. Clients may shorten the deadline
+// of the server but neither drop nor extend it, anything but a positive number of milliseconds is ignored
+template<typename Request>
+std::chrono::milliseconds
+get_request_timeout(const Request& request, std::chrono::milliseconds timeout)
+{
+  const auto header = request.base( ).find("X-Request-Timeout");
+  if (header == request.base( ).end( )) {
+    return timeout;
+  }
+
+  const auto limit = timeout.count( ) > 0 ? timeout : max_request_timeout;
+  auto requested = std::chrono::milliseconds::rep{ 0 };
+  for (const auto c : header->value( )) {
+    if (c < '0' || c > '9') {
+      return timeout;
+    }
+    requested = std::min<std::chrono::milliseconds::rep>(requested * 10 + (c - '0'), limit.count( ));
+  }
+  return requested > 0 ? std::chrono::milliseconds{ requested } : timeout;
+}
+}
+
 template<typename DoRead>
 void
-run_http_event_loop(DoRead do_read)
+run_http_event_loop(DoRead do_read, std::chrono::milliseconds timeout)
 {
   namespace http = boost::beast::http;
   using json = nlohmann::json;
@@ -47,14 +86,18 @@ run_http_event_loop(DoRead do_read)
     }
 
     logger.debug(json_object.dump( ));
-    on_next(status_t::DATA_TRANSMISSION, json_object);
+    // The next read fills the same request, the reply only gets what it needs of this one
+    const auto response_of = response_info_t{ request->version( ), request->keep_alive( ) };
+    on_next(status_t::DATA_TRANSMISSION, json_object, get_request_timeout(*request, timeout), response_of);
 
-    run_http_event_loop(do_read);
+    run_http_event_loop(do_read, timeout);
   });
 }
 
 auto
-make_http_event_loop(const std::shared_ptr<ServiceContext>& context, const Logger& logger)
+make_http_event_loop(const std::shared_ptr<ServiceContext>& context,
+                     const http_server_options_t& options,
+                     const Logger& logger)
 {
   namespace http = boost::beast::http;
 
@@ -63,51 +106,85 @@ make_http_event_loop(const std::shared_ptr<ServiceContext>& context, const Logge
   using strand_t = boost::asio::strand<boost::asio::io_context::executor_type>;
   using error_t = boost::system::error_code;
 
+  // Shared by all connections of the service, the pipelines are called by one thread at a time however many session
+  // threads read requests
+  auto service_strand =
+    options.run_to_completion ? nullptr : std::make_shared<strand_t>(context->get_service_context( ).get_executor( ));
+
   return [=](const socket_tp& socket) {
     using result_t = ServicePacket;
 
-    auto session_strand = std::make_shared<strand_t>(context->get_session_context( ).get_executor( ));
-    auto service_strand = std::make_shared<strand_t>(context->get_service_context( ).get_executor( ));
+    auto session_strand = std::make_shared<strand_t>(get_io_context(*socket).get_executor( ));
+
+    // Calls into the pipelines on the service strand, or right away when running to completion
+    auto to_pipelines = [service_strand](auto fn) {
+      if (service_strand) {
+        boost::asio::dispatch(*service_strand, std::move(fn));
+      } else {
+        fn( );
+      }
+    };
 
     auto on_subscribe = [=](auto subscriber) {
       using status_t = ServicePacket::EStatus;
-      using data_t = const std::string&;
+      using data_t = ServicePacket::reply_t;
 
       auto buffer = std::make_shared<boost::beast::flat_buffer>( );
       auto request = std::make_shared<http::request<http::string_body>>( );
 
-      auto on_write = [=](data_t data) {
-        auto response = http::response<http::string_body>{ http::status::ok, request->version( ) };
+      // Replies are written on the session strand, which the reads of the connection run on too, whatever the thread
+      // that made them
+      auto write = [=](http::status status, data_t data, response_info_t response_of) {
+        // The body refers directly to the shared reply, which is kept alive until the write completes
+        using body_t = http::span_body<const char>;
+        auto response = http::response<body_t>{ status, response_of.version };
         response.set(http::field::server, "1.0");
         response.set(http::field::content_type, "text/html");
-        response.keep_alive(request->keep_alive( ));
-        response.body( ) = data;
+        response.keep_alive(response_of.keep_alive);
+        response.body( ) = body_t::value_type{ data->data( ), data->size( ) };
         response.prepare_payload( );
-        using message_type = http::message<false, decltype(response)::body_type, decltype(response)::fields_type>;
-        auto message = std::make_shared<message_type>(std::move(response));
+        auto message = std::make_shared<decltype(response)>(std::move(response));
         auto fn = [=] {
-          auto cb = [message, socket, session_strand](error_t, std::size_t) {};
-          http::async_write(*socket, *message, boost::asio::bind_executor(*session_strand, cb));
+          auto cb = [message, data, socket](error_t, std::size_t) {};
+          http::async_write(*socket, *message, boost::asio::bind_executor(*session_strand, std::move(cb)));
         };
-        boost::asio::bind_executor(*service_strand, fn)( );
+        if (session_strand->running_in_this_thread( )) {
+          fn( );
+        } else {
+          boost::asio::post(*session_strand, std::move(fn));
+        }
       };
 
-      auto on_next = [=](status_t status, nlohmann::json data = {}) {
-        auto fn = boost::asio::bind_executor(*service_strand, [=] {
-          subscriber.on_next(ServicePacket{ status, ServicePacket::payload_t{ std::move(data) }, on_write });
-        });
-        fn( );
+      auto on_next = [=](status_t status,
+                         nlohmann::json data = {},
+                         std::chrono::milliseconds timeout = { },
+                         response_info_t response_of = { }) {
+        auto on_reply =
+          ServicePacket::make_on_reply([=](data_t reply) { write(http::status::ok, std::move(reply), response_of); });
+        auto deadline = ServicePacket::shared_deadline_t{ };
+        if (timeout.count( ) > 0) {
+          // Whichever comes first of the reply and a stage dropping the expired request answers the client
+          auto answered = std::make_shared<std::atomic<bool>>(false);
+          on_reply = ServicePacket::make_on_reply([=](data_t reply) {
+            if (!answered->exchange(true)) {
+              write(http::status::ok, std::move(reply), response_of);
+            }
+          });
+          auto on_expired = [=] {
+            if (!answered->exchange(true)) {
+              write(http::status::gateway_timeout, std::make_shared<const std::string>( ), response_of);
+            }
+          };
+          deadline = ServicePacket::make_deadline(ServicePacket::clock_t::now( ) + timeout, std::move(on_expired));
+        }
+        auto packet = ServicePacket{ status, ServicePacket::payload_t{ std::move(data) }, std::move(on_reply) }
+                        .with_deadline(std::move(deadline));
+        to_pipelines([=] { subscriber.on_next(packet); });
       };
 
-      auto on_error = [=](std::exception_ptr e) {
-        auto fn = boost::asio::bind_executor(*service_strand, [=] { subscriber.on_error(e); });
-        fn( );
-      };
+      auto on_error = [=](std::exception_ptr e) { to_pipelines([=] { subscriber.on_error(e); }); };
 
-      auto on_completed = [=]( ) {
-        auto fn = boost::asio::bind_executor(*service_strand, [=]( ) { subscriber.on_completed( ); });
-        fn( );
-      };
+      auto on_completed = [=]( ) { to_pipelines([=] { subscriber.on_completed( ); }); };
 
       on_next(status_t::CONNECTED);
 
@@ -118,7 +195,7 @@ make_http_event_loop(const std::shared_ptr<ServiceContext>& context, const Logge
         http::async_read(
           *socket, *buffer, *request, boost::asio::bind_executor(*session_strand, std::move(read_callback)));
       };
-      run_http_event_loop(std::move(do_read));
+      run_http_event_loop(std::move(do_read), options.timeout);
     };
 
     return rxcpp::observable<>::create<result_t>(std::move(on_subscribe));
@@ -129,11 +206,13 @@ rxcpp::observable<ServicePacket>
 create_http_server(const std::shared_ptr<ServiceContext>& context,
                    const std::string& host,
                    unsigned short port,
+                   const http_server_options_t& options,
                    const Logger& logger)
 {
-  auto tcp_listener = make_tcp_listener(context, logger, host, port);
-  auto tcp_acceptor = make_tcp_acceptor(context, logger);
-  auto http_event_loop = make_http_event_loop(context, logger);
+  const auto nof_acceptors = options.acceptors > 0 ? options.acceptors : context->get_nof_session_threads( );
+  auto tcp_listener = make_tcp_listener(context, logger, host, port, nof_acceptors, options.reuse_port);
+  auto tcp_acceptor = make_tcp_acceptor(context, logger, nof_acceptors);
+  auto http_event_loop = make_http_event_loop(context, options, logger);
 
   return tcp_listener( ).flat_map(std::move(tcp_acceptor)).flat_map(std::move(http_event_loop));
 }
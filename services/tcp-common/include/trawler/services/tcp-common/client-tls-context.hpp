@@ -0,0 +1,117 @@
+#pragma once
+#include <boost/asio/ssl/context.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <openssl/ssl.h>
+#include <string>
+#include <trawler/services/tcp-common/load-root-certificates.hpp>
+
+namespace trawler {
+
+/*******************************************************************************
+ * ClientTlsContext
+ *
+ * The TLS context shared by every outbound connection of the process. The root
+ * certificates are loaded once, and the latest session negotiated with each
+ * host is cached so that later connections to it can resume the session
+ * instead of doing a full handshake.
+ ******************************************************************************/
+class ClientTlsContext
+{
+  boost::asio::ssl::context context{ boost::asio::ssl::context::sslv23_client };
+  std::mutex mutex;
+  std::map<std::string, SSL_SESSION*> sessions;
+
+  // Called by OpenSSL whenever a session is established, including TLS 1.3
+  // tickets arriving after the handshake. OpenSSL marks the session of a
+  // connection that is not shut down cleanly as not resumable, so the cache
+  // only ever hands out and keeps copies.
+  static int on_new_session(SSL* ssl, SSL_SESSION* session)
+  {
+    const auto* host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    auto* self = static_cast<ClientTlsContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    if (host == nullptr || self == nullptr) {
+      return 0;
+    }
+
+    auto* copy = SSL_SESSION_dup(session);
+    if (copy == nullptr) {
+      return 0;
+    }
+
+    std::lock_guard<std::mutex> lock{ self->mutex };
+    auto& cached = self->sessions[host];
+    if (cached != nullptr) {
+      SSL_SESSION_free(cached);
+    }
+    cached = copy;
+    return 0;
+  }
+
+public:
+  ClientTlsContext( )
+  {
+    context.set_options(boost::asio::ssl::context::default_workarounds);
+    load_root_certificates(context);
+
+    auto* native = context.native_handle( );
+    SSL_CTX_set_app_data(native, this);
+    SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(native, &ClientTlsContext::on_new_session);
+  }
+
+  ClientTlsContext(const ClientTlsContext&) = delete;
+  ClientTlsContext(ClientTlsContext&&) = delete;
+  ClientTlsContext& operator=(const ClientTlsContext&) = delete;
+  ClientTlsContext& operator=(ClientTlsContext&&) = delete;
+
+  ~ClientTlsContext( )
+  {
+    SSL_CTX_set_app_data(context.native_handle( ), nullptr);
+    for (auto& [host, session] : sessions) {
+      SSL_SESSION_free(session);
+    }
+  }
+
+  boost::asio::ssl::context& get( ) { return context; }
+
+  // Sets the SNI host name of a connection about to handshake, and offers the
+  // cached session for the host if there is one
+  bool prepare(SSL* ssl, const std::string& host)
+  {
+    if (!SSL_set_tlsext_host_name(ssl, host.c_str( ))) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock{ mutex };
+    const auto found = sessions.find(host);
+    if (found != cend(sessions)) {
+      auto* copy = SSL_SESSION_dup(found->second);
+      if (copy != nullptr) {
+        SSL_set_session(ssl, copy);
+        SSL_SESSION_free(copy);
+      }
+    }
+    return true;
+  }
+
+  bool has_session(const std::string& host)
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    return sessions.find(host) != cend(sessions);
+  }
+};
+
+/*******************************************************************************
+ * get_client_tls_context
+ *
+ * Returns the process-wide ClientTlsContext.
+ ******************************************************************************/
+inline const std::shared_ptr<ClientTlsContext>&
+get_client_tls_context( )
+{
+  static const auto instance = std::make_shared<ClientTlsContext>( );
+  return instance;
+}
+}
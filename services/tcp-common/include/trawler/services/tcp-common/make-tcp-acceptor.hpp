@@ -26,7 +26,6 @@ run_acceptor_loop(DoAccept do_accept)
       return;
     }
 
-    const auto address = socket->remote_endpoint( ).address( );
     logger.info("Client connected!");
 
     on_next(std::move(socket));
@@ -37,10 +36,16 @@ run_acceptor_loop(DoAccept do_accept)
 
 /*******************************************************************************
  * make_tcp_acceptor
+ *
+ * Accepts connections on each acceptor. A lone acceptor hands its connections
+ * to the session shards in turn, while one of several acceptors made by
+ * make_tcp_listener keeps them on its own shard.
  ******************************************************************************/
 inline
 auto
-make_tcp_acceptor(const std::shared_ptr<ServiceContext>& context, const Logger& logger)
+make_tcp_acceptor(const std::shared_ptr<ServiceContext>& context,
+                  const Logger& logger,
+                  const std::size_t nof_acceptors = 1)
 {
   using acceptor_t = boost::asio::ip::tcp::acceptor;
   using acceptor_tp = std::shared_ptr<acceptor_t>;
@@ -71,7 +76,9 @@ make_tcp_acceptor(const std::shared_ptr<ServiceContext>& context, const Logger&
       };
 
       auto do_accept = [=](auto on_accept_impl) {
-        auto socket = std::make_shared<socket_t>(context->get_session_context( ));
+        // The connection stays on the session shard it is accepted onto for as long as it lives
+        auto& session = nof_acceptors > 1 ? get_io_context(*acceptor) : context->get_session_shard( );
+        auto socket = std::make_shared<socket_t>(session);
         auto on_accept = [=](error_t ec) { on_accept_impl(ec, logger, socket, on_next, on_error, on_completed); };
         acceptor->async_accept(*socket, std::move(on_accept));
       };
@@ -4,60 +4,94 @@
 #include <memory>
 #include <rxcpp/rx.hpp>
 #include <string>
+#include <sys/socket.h>
 #include <trawler/logging/logger.hpp>
 #include <trawler/services/make-runtime-error.hpp>
 #include <trawler/services/service-context.hpp>
+#include <vector>
 
 namespace trawler {
+
 /*******************************************************************************
  * make_tcp_listener
+ *
+ * Emits the acceptors listening on host:port. With more than one acceptor
+ * every one of them is bound with SO_REUSEPORT, so the kernel spreads new
+ * connections over them, and each is put on a session shard of its own.
+ * A single acceptor is bound with SO_REUSEPORT too if `reuse_port` is set,
+ * letting other processes listen on the same port.
  ******************************************************************************/
 inline
 auto
 make_tcp_listener(const std::shared_ptr<ServiceContext>& context,
                   const Logger& logger,
                   const std::string& host,
-                  const unsigned short port)
+                  const unsigned short port,
+                  const std::size_t nof_acceptors = 1,
+                  const bool reuse_port = false)
 {
   using acceptor_t = boost::asio::ip::tcp::acceptor;
   using acceptor_tp = std::shared_ptr<acceptor_t>;
   using endpoint_t = boost::asio::ip::tcp::endpoint;
+  // Asio has no public option for SO_REUSEPORT
+  using reuse_port_t = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
 
   return [=] {
     using result_t = acceptor_tp;
 
     auto on_subscribe = [=](auto subscriber) {
-      auto acceptor = std::make_shared<acceptor_t>(context->get_session_context( ));
-
-      boost::system::error_code ec;
+      const auto sharded = nof_acceptors > 1;
+      auto acceptors = std::vector<acceptor_tp>{ };
       auto endpoint = endpoint_t{ boost::asio::ip::make_address(host), port };
 
-      acceptor->open(endpoint.protocol( ), ec);
-      if (ec) {
-        subscriber.on_error(make_runtime_error(ec));
-        return;
-      }
+      for (auto n = std::size_t{ 0 }; n < std::max(nof_acceptors, std::size_t{ 1 }); ++n) {
+        auto& session = sharded ? context->get_session_shard( ) : context->get_session_context( );
+        auto acceptor = std::make_shared<acceptor_t>(session);
 
-      acceptor->set_option(boost::asio::socket_base::reuse_address(true), ec);
-      if (ec) {
-        subscriber.on_error(make_runtime_error(ec));
-        return;
-      }
+        boost::system::error_code ec;
 
-      acceptor->bind(endpoint, ec);
-      if (ec) {
-        subscriber.on_error(make_runtime_error(ec));
-        return;
-      }
+        acceptor->open(endpoint.protocol( ), ec);
+        if (ec) {
+          subscriber.on_error(make_runtime_error(ec));
+          return;
+        }
 
-      acceptor->listen(boost::asio::socket_base::max_listen_connections, ec);
-      if (ec) {
-        subscriber.on_error(make_runtime_error(ec));
-        return;
+        acceptor->set_option(boost::asio::socket_base::reuse_address(true), ec);
+        if (ec) {
+          subscriber.on_error(make_runtime_error(ec));
+          return;
+        }
+
+        if (sharded || reuse_port) {
+          acceptor->set_option(reuse_port_t(true), ec);
+          if (ec) {
+            subscriber.on_error(make_runtime_error(ec));
+            return;
+          }
+        }
+
+        acceptor->bind(endpoint, ec);
+        if (ec) {
+          subscriber.on_error(make_runtime_error(ec));
+          return;
+        }
+
+        acceptor->listen(boost::asio::socket_base::max_listen_connections, ec);
+        if (ec) {
+          subscriber.on_error(make_runtime_error(ec));
+          return;
+        }
+
+        // The other acceptors share the port picked for the first one when asked for any port
+        endpoint = acceptor->local_endpoint( );
+        acceptors.push_back(std::move(acceptor));
       }
 
-      logger.info("Listening for connections on " + host + ":" + std::to_string(port));
-      subscriber.on_next(acceptor);
+      logger.info("Listening for connections on " + host + ":" + std::to_string(endpoint.port( )) + " with " +
+                  std::to_string(acceptors.size( )) + (acceptors.size( ) == 1 ? " acceptor" : " acceptors"));
+      for (const auto& acceptor : acceptors) {
+        subscriber.on_next(acceptor);
+      }
       subscriber.on_completed( );
     };
     return rxcpp::observable<>::create<result_t>(std::move(on_subscribe));
@@ -8,12 +8,14 @@ create_websocket_client(const std::shared_ptr<class ServiceContext>& context,
                         const std::string& host,
                         unsigned short port,
                         const std::string& target,
-                        const Logger& logger = { "websocket-client" });
+                        const Logger& logger = { "websocket-client" },
+                        bool run_to_completion = false);
 
 rxcpp::observable<class ServicePacket>
 create_websocket_client_ssl(const std::shared_ptr<class ServiceContext>& context,
                             const std::string& host,
                             unsigned short port,
                             const std::string& target,
-                            const Logger& logger = { "websocket-client" });
+                            const Logger& logger = { "websocket-client" },
+                            bool run_to_completion = false);
 }
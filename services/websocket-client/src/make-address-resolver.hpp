@@ -22,10 +22,8 @@ make_address_resolver(const std::shared_ptr<ServiceContext>& context,
     using error_t = boost::system::error_code;
     using result_t = tcp::resolver::results_type;
 
-    auto resolver = std::make_shared<tcp::resolver>(context->get_session_context( ));
-
-    auto on_subscribe = [resolver, logger, host, port](auto subscriber) {
-      auto on_resolve = [resolver, logger, subscriber](error_t ec, const result_t& results) {
+    auto on_subscribe = [context, logger, host, port](auto subscriber) {
+      auto on_resolve = [logger, subscriber](error_t ec, const result_t& results) {
         if (ec) {
           logger.critical("Address resolution failed");
           subscriber.on_error(make_runtime_error(ec));
@@ -36,7 +34,7 @@ make_address_resolver(const std::shared_ptr<ServiceContext>& context,
         subscriber.on_completed( );
       };
 
-      resolver->async_resolve(host, port, std::move(on_resolve));
+      context->get_resolver_cache( ).async_resolve(host, port, std::move(on_resolve));
     };
 
     return rxcpp::observable<>::create<result_t>(std::move(on_subscribe));
@@ -55,14 +55,15 @@ create_websocket_client(const std::shared_ptr<ServiceContext>& context,
                         const std::string& host,
                         unsigned short port,
                         const std::string& target,
-                        const Logger& logger)
+                        const Logger& logger,
+                        bool run_to_completion)
 {
   using namespace rxcpp::operators;
 
   auto address_resolver = make_address_resolver(context, logger, host, std::to_string(port));
   auto websocket_connector = make_websocket_connector(context, logger);
   auto websocket_handshaker = make_websocket_handshaker<stream_t>(logger, host, target);
-  auto event_loop = make_websocket_event_loop<stream_t>(context, logger);
+  auto event_loop = make_websocket_event_loop<stream_t>(context, logger, run_to_completion);
 
   return address_resolver( )
     .flat_map(std::move(websocket_connector))
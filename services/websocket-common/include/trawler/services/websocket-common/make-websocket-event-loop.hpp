@@ -1,5 +1,7 @@
 #pragma once
 #include <boost/asio/bind_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/core/buffers_to_string.hpp>
@@ -7,6 +9,7 @@
 #include <rxcpp/rx.hpp>
 #include <trawler/logging/logger.hpp>
 #include <trawler/services/make-runtime-error.hpp>
+#include <trawler/services/service-context.hpp>
 #include <trawler/services/service-packet.hpp>
 
 namespace trawler {
@@ -51,51 +54,66 @@ run_websocket_event_loop(DoRead do_read)
 
 /*******************************************************************************
  * make_websocket_event_loop
+ *
+ * With run_to_completion the pipelines are called on the session thread that
+ * read the message and replies made there are written right away, replies
+ * made on another thread are handed back to the session strand.
  ******************************************************************************/
 template<typename Stream>
 inline auto
-make_websocket_event_loop(const std::shared_ptr<ServiceContext>& context, const Logger& logger)
+make_websocket_event_loop(const std::shared_ptr<ServiceContext>& context,
+                          const Logger& logger,
+                          bool run_to_completion = false)
 {
   using stream_t = Stream;
   using stream_tp = std::shared_ptr<stream_t>;
   using strand_t = asio::strand<asio::io_context::executor_type>;
   using error_t = boost::system::error_code;
 
+  // Shared by all streams of the service, the pipelines are called by one thread at a time however many session
+  // threads read messages
+  auto service_strand =
+    run_to_completion ? nullptr : std::make_shared<strand_t>(context->get_service_context( ).get_executor( ));
+
   return [=](const stream_tp& stream) {
     using result_t = ServicePacket;
 
     auto buffer = std::make_shared<beast::multi_buffer>( );
-    auto session_strand = std::make_shared<strand_t>(context->get_session_context( ).get_executor( ));
-    auto service_strand = std::make_shared<strand_t>(context->get_service_context( ).get_executor( ));
+    auto session_strand = std::make_shared<strand_t>(get_io_context(*stream).get_executor( ));
+
+    auto to_pipelines = [service_strand](auto fn) {
+      if (service_strand) {
+        asio::dispatch(*service_strand, std::move(fn));
+      } else {
+        fn( );
+      }
+    };
 
     auto on_subscribe = [=](auto subscriber) {
       using status_t = ServicePacket::EStatus;
-      using data_t = const std::string&;
+      using data_t = ServicePacket::reply_t;
 
-      auto on_write = [=](data_t data) {
+      // Replies are written on the session strand the reads of the stream run on, whatever the thread that made them
+      auto on_write = ServicePacket::make_on_reply([=](data_t data) {
         auto fn = [=] {
-          auto cb = [](error_t, std::size_t) {};
-          stream->async_write(asio::buffer(data), asio::bind_executor(*session_strand, std::move(cb)));
+          auto cb = [data, stream](error_t, std::size_t) {};
+          stream->async_write(asio::buffer(*data), asio::bind_executor(*session_strand, std::move(cb)));
         };
-        asio::bind_executor(*service_strand, fn)( );
-      };
-
-      auto on_error = [=](std::exception_ptr e) {
-        auto fn = asio::bind_executor(*service_strand, [=] { subscriber.on_error(e); });
-        fn( );
-      };
-
-      auto on_next = [=](status_t status, data_t data = "") {
-        auto fn = asio::bind_executor(*service_strand, [=] {
-          subscriber.on_next(ServicePacket{ status, { data }, on_write });
-        });
-        fn( );
+        if (session_strand->running_in_this_thread( )) {
+          fn( );
+        } else {
+          asio::post(*session_strand, std::move(fn));
+        }
+      });
+
+      auto on_error = [=](std::exception_ptr e) { to_pipelines([=] { subscriber.on_error(e); }); };
+
+      auto on_next = [=](status_t status, std::string data = "") {
+        auto packet = ServicePacket{ status, { std::move(data) }, on_write };
+        to_pipelines([=] { subscriber.on_next(packet); });
       };
 
-      auto on_completed = [=]( ) {
-        auto fn = asio::bind_executor(*service_strand, [=]( ) { subscriber.on_completed( ); });
-        fn( );
-      };
+      auto on_completed = [=]( ) { to_pipelines([=] { subscriber.on_completed( ); }); };
 
       on_next(status_t::CONNECTED);
 
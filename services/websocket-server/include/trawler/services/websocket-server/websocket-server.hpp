@@ -7,5 +7,6 @@ rxcpp::observable<class ServicePacket>
 create_websocket_server(const std::shared_ptr<class ServiceContext>& context,
                         const std::string& host,
                         unsigned short port,
-                        const Logger& logger = { "websocket-server" });
+                        const Logger& logger = { "websocket-server" },
+                        bool run_to_completion = false);
 }
@@ -47,12 +47,13 @@ rxcpp::observable<ServicePacket>
 create_websocket_server(const std::shared_ptr<ServiceContext>& context,
                         const std::string& host,
                         unsigned short port,
-                        const Logger& logger)
+                        const Logger& logger,
+                        bool run_to_completion)
 {
   auto tcp_listener = make_tcp_listener(context, logger, host, port);
   auto tcp_acceptor = make_tcp_acceptor(context, logger);
   auto websocket_acceptor = make_websocket_acceptor(context, logger);
-  auto websocket_event_loop = make_websocket_event_loop<stream_t>(context, logger);
+  auto websocket_event_loop = make_websocket_event_loop<stream_t>(context, logger, run_to_completion);
 
   return tcp_listener( )
     .flat_map(std::move(tcp_acceptor))
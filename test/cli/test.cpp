@@ -1,7 +1,24 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <doctest.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <rxcpp/rx.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <trawler/cli/optimize-configuration.hpp>
 #include <trawler/cli/parse-configuration.hpp>
 #include <trawler/cli/parse-options.hpp>
+#include <trawler/cli/spawn-pipelines.hpp>
+#include <trawler/cli/supervise-workers.hpp>
+#include <trawler/services/service-context.hpp>
+#include <unistd.h>
+#include <variant>
 #include <vector>
 
 auto
@@ -40,6 +57,20 @@ SCENARIO("Options")
     }
   }
 
+  GIVEN("thread counts")
+  {
+    const auto [vm, desc, err] =
+      parse({ "progname", "--session-threads", "4", "--service-threads", "2", "--sharded", "config.yaml" });
+
+    THEN("they should be found in the variables map")
+    {
+      REQUIRE(err == nullptr);
+      CHECK(vm["session-threads"].as<unsigned>( ) == 4);
+      CHECK(vm["service-threads"].as<unsigned>( ) == 2);
+      CHECK(vm["sharded"].as<bool>( ));
+    }
+  }
+
   GIVEN("several configuration files as input")
   {
     const auto [vm, desc, err] = parse({ "progname", "config1.yaml", "config2.yaml" });
@@ -73,6 +104,57 @@ SCENARIO("configuration")
     CHECK(websocket_client_service.port == 111);
     CHECK(websocket_client_service.target == "/target");
     CHECK(websocket_client_service.ssl == false);
+    CHECK_FALSE(websocket_client_service.run_to_completion);
+  }
+
+  GIVEN("an http server service with a request timeout and several acceptors")
+  {
+    const auto configuration = trawler::parse_configuration(R"#(
+    services:
+      - name: my-http-server
+        service: http-server
+        host: 0.0.0.0
+        port: 8080
+        timeout_ms: 1500
+        acceptors: 4
+        reuse_port: true
+    )#");
+    const auto services = configuration.services;
+    REQUIRE(services.size( ) == 1);
+
+    const auto service = services.front( );
+    REQUIRE(std::holds_alternative<trawler::config::http_server_service_t>(service));
+
+    const auto http_server_service = std::get<trawler::config::http_server_service_t>(service);
+    CHECK(http_server_service.name == "my-http-server");
+    CHECK(http_server_service.port == 8080);
+    CHECK(http_server_service.timeout_ms == 1500);
+    CHECK(http_server_service.acceptors == 4);
+    CHECK(http_server_service.reuse_port);
+  }
+
+  GIVEN("services running to completion")
+  {
+    const auto configuration = trawler::parse_configuration(R"#(
+    services:
+      - name: my-websocket-client
+        service: websocket-client
+        host: myhost.com
+        port: 111
+        target: /target
+        ssl: false
+        run_to_completion: true
+      - name: my-http-server
+        service: http-server
+        host: 0.0.0.0
+        port: 8080
+        run_to_completion: true
+    )#");
+    const auto services = configuration.services;
+    REQUIRE(services.size( ) == 2);
+
+    CHECK(std::get<trawler::config::websocket_client_service_t>(services[0]).run_to_completion);
+    CHECK(std::get<trawler::config::http_server_service_t>(services[1]).run_to_completion);
   }
 
   GIVEN("an endpoint")
@@ -89,3 +171,627 @@ SCENARIO("configuration")
     CHECK(endpoint == "my-endpoint");
   }
 }
+
+SCENARIO("http-client configuration")
+{
+  GIVEN("an http-client pipeline")
+  {
+    const auto configuration = trawler::parse_configuration(R"#(
+    pipelines:
+      - name: my-http-client
+        pipeline: http-client
+        source: my-source
+        ssl: true
+        max_in_flight: 8
+        coalesce: false
+        cache_bytes: 1048576
+        retries: 2
+        retry_backoff_ms: 50
+        hedge_percentile: 95
+        hedge_delay_ms: 20
+        max_body_bytes: 4096
+        streaming: ndjson
+    )#");
+    REQUIRE(configuration.pipelines.size( ) == 1);
+
+    const auto pipeline = configuration.pipelines.front( );
+    REQUIRE(std::holds_alternative<trawler::config::http_client_pipeline_t>(pipeline));
+
+    const auto http_client_pipeline = std::get<trawler::config::http_client_pipeline_t>(pipeline);
+    CHECK(http_client_pipeline.name == "my-http-client");
+    CHECK(http_client_pipeline.source == "my-source");
+    CHECK(http_client_pipeline.ssl == true);
+    CHECK(http_client_pipeline.max_in_flight == 8);
+    CHECK(http_client_pipeline.coalesce == false);
+    CHECK(http_client_pipeline.cache_bytes == 1048576);
+    CHECK(http_client_pipeline.retries == 2);
+    CHECK(http_client_pipeline.retry_backoff_ms == 50);
+    CHECK(http_client_pipeline.hedge_percentile == 95);
+    CHECK(http_client_pipeline.hedge_delay_ms == 20);
+    CHECK(http_client_pipeline.max_body_bytes == 4096);
+    CHECK(http_client_pipeline.streaming == "ndjson");
+  }
+}
+
+SCENARIO("http-scatter-gather configuration")
+{
+  GIVEN("an http-scatter-gather pipeline")
+  {
+    const auto configuration = trawler::parse_configuration(R"#(
+    pipelines:
+      - name: my-scatter-gather
+        pipeline: http-scatter-gather
+        source: my-source
+        max_in_flight: 16
+        timeout_ms: 250
+    )#");
+    REQUIRE(configuration.pipelines.size( ) == 1);
+
+    const auto pipeline = configuration.pipelines.front( );
+    REQUIRE(std::holds_alternative<trawler::config::http_scatter_gather_pipeline_t>(pipeline));
+
+    const auto scatter_gather_pipeline = std::get<trawler::config::http_scatter_gather_pipeline_t>(pipeline);
+    CHECK(scatter_gather_pipeline.name == "my-scatter-gather");
+    CHECK(scatter_gather_pipeline.source == "my-source");
+    CHECK(scatter_gather_pipeline.max_in_flight == 16);
+    CHECK(scatter_gather_pipeline.timeout_ms == 250);
+  }
+}
+
+SCENARIO("pipeline parallelism configuration")
+{
+  GIVEN("a parallel unordered pipeline and a serial one")
+  {
+    const auto configuration = trawler::parse_configuration(R"#(
+    pipelines:
+      - name: parallel
+        pipeline: jq
+        source: my-service
+        script: .
+        parallelism: 4
+        ordered: false
+      - name: serial
+        pipeline: jq
+        source: my-service
+        script: .
+    )#");
+
+    const auto& parallel = std::get<trawler::config::jq_pipeline_t>(configuration.pipelines[0]);
+    CHECK(parallel.parallelism == 4);
+    CHECK_FALSE(parallel.ordered);
+
+    const auto& serial = std::get<trawler::config::jq_pipeline_t>(configuration.pipelines[1]);
+    CHECK(serial.parallelism == 1);
+    CHECK(serial.ordered);
+  }
+
+  GIVEN("a partitioned pipeline")
+  {
+    const auto configuration = trawler::parse_configuration(R"#(
+    pipelines:
+      - name: partitioned
+        pipeline: jq
+        source: my-service
+        script: .
+        parallelism: 4
+        partition: /pair
+    )#");
+
+    const auto& partitioned = std::get<trawler::config::jq_pipeline_t>(configuration.pipelines[0]);
+    CHECK(partitioned.partition == "/pair");
+    CHECK_FALSE(partitioned.ordered);
+  }
+
+  GIVEN("a partition that is not a JSON pointer")
+  {
+    CHECK_THROWS(trawler::parse_configuration(R"#(
+    pipelines:
+      - name: partitioned
+        pipeline: jq
+        source: my-service
+        script: .
+        parallelism: 4
+        partition: pair
+    )#"));
+  }
+
+  GIVEN("a partition without parallelism")
+  {
+    CHECK_THROWS(trawler::parse_configuration(R"#(
+    pipelines:
+      - name: partitioned
+        pipeline: jq
+        source: my-service
+        script: .
+        partition: /pair
+    )#"));
+  }
+
+  GIVEN("a partitioned buffer pipeline")
+  {
+    CHECK_THROWS(trawler::parse_configuration(R"#(
+    pipelines:
+      - name: partitioned
+        pipeline: buffer
+        source: my-service
+        trigger_source: my-service
+        parallelism: 4
+        partition: /pair
+    )#"));
+  }
+
+  GIVEN("a parallelism of zero")
+  {
+    CHECK_THROWS(trawler::parse_configuration(R"#(
+    pipelines:
+      - name: none
+        pipeline: jq
+        source: my-service
+        script: .
+        parallelism: 0
+    )#"));
+  }
+}
+
+SCENARIO("resolver configuration")
+{
+  GIVEN("resolver ttls")
+  {
+    const auto configuration = trawler::parse_configuration(R"#(
+    resolver:
+      ttl: 300
+      negative_ttl: 10
+    )#");
+
+    CHECK(configuration.resolver.ttl == 300);
+    CHECK(configuration.resolver.negative_ttl == 10);
+  }
+
+  GIVEN("thread counts")
+  {
+    const auto configuration = trawler::parse_configuration(R"#(
+    threads:
+      session: 8
+      service: 0
+      sharded: true
+    )#");
+
+    CHECK(configuration.threads.session == 8);
+    CHECK(configuration.threads.service == 0);
+    CHECK(configuration.threads.sharded);
+  }
+
+  GIVEN("no resolver section")
+  {
+    const auto configuration = trawler::parse_configuration(R"#(
+    endpoints:
+      - my-endpoint
+    )#");
+
+    CHECK(configuration.resolver.ttl == 60);
+    CHECK(configuration.resolver.negative_ttl == 5);
+    CHECK(configuration.threads.session == 1);
+    CHECK(configuration.threads.service == 1);
+    CHECK_FALSE(configuration.threads.sharded);
+  }
+}
+
+auto
+get_pipeline_names(const trawler::configuration_t& configuration)
+{
+  auto names = std::vector<std::string>{ };
+  for (const auto& pipe : configuration.pipelines) {
+    names.push_back(std::visit([](const auto& p) { return p.name; }, pipe));
+  }
+  return names;
+}
+
+SCENARIO("configuration optimizer")
+{
+  GIVEN("a pipeline no endpoint depends on")
+  {
+    const auto configuration = trawler::optimize_configuration(trawler::parse_configuration(R"#(
+    pipelines:
+      - name: used
+        pipeline: http-client
+        source: my-service
+      - name: unused
+        pipeline: http-client
+        source: my-service
+    endpoints:
+      - used
+    )#"));
+
+    THEN("it is removed")
+    {
+      const auto expected = std::vector<std::string>{ "used" };
+      CHECK(get_pipeline_names(configuration) == expected);
+    }
+  }
+
+  GIVEN("identical jq stages on the same source")
+  {
+    const auto configuration = trawler::optimize_configuration(trawler::parse_configuration(R"#(
+    pipelines:
+      - name: first
+        pipeline: jq
+        source: my-service
+        script: .value
+      - name: second
+        pipeline: jq
+        source: my-service
+        script: .value
+      - name: other-events
+        pipeline: jq
+        source: my-service
+        event: [ "connected" ]
+        script: .value
+      - name: consumer
+        pipeline: http-client
+        source: second
+    endpoints:
+      - first
+      - second
+      - other-events
+      - consumer
+    )#"));
+
+    THEN("the duplicate is merged into the first one")
+    {
+      const auto expected = std::vector<std::string>{ "first", "other-events", "consumer" };
+      CHECK(get_pipeline_names(configuration) == expected);
+      CHECK(std::get<trawler::config::http_client_pipeline_t>(configuration.pipelines[2]).source == "first");
+      CHECK(configuration.endpoints == expected);
+    }
+  }
+
+  GIVEN("a chain of pure stages")
+  {
+    const auto configuration = trawler::optimize_configuration(trawler::parse_configuration(R"#(
+    pipelines:
+      - name: emit
+        pipeline: emit
+        source: my-service
+        data: "{}"
+      - name: jq
+        pipeline: jq
+        source: emit
+        script: .
+      - name: inja
+        pipeline: inja
+        source: jq
+        template: "{{ value }}"
+    endpoints:
+      - inja
+    )#"));
+
+    THEN("it is fused into one pipeline")
+    {
+      REQUIRE(configuration.pipelines.size( ) == 1);
+      CHECK(get_pipeline_names(configuration).front( ) == "inja");
+      const auto& fused = std::get<trawler::config::fused_pipeline_t>(configuration.pipelines.front( ));
+      CHECK(fused.source == "my-service");
+      REQUIRE(fused.stages.size( ) == 3);
+      CHECK(std::holds_alternative<trawler::config::emit_pipeline_t>(fused.stages[0]));
+      CHECK(std::holds_alternative<trawler::config::jq_pipeline_t>(fused.stages[1]));
+      CHECK(std::holds_alternative<trawler::config::inja_pipeline_t>(fused.stages[2]));
+    }
+  }
+
+  GIVEN("pure stages with several consumers or jq stages")
+  {
+    const auto configuration = trawler::optimize_configuration(trawler::parse_configuration(R"#(
+    pipelines:
+      - name: shared
+        pipeline: emit
+        source: my-service
+        data: "{}"
+      - name: first-jq
+        pipeline: jq
+        source: shared
+        script: .a
+      - name: second-jq
+        pipeline: jq
+        source: first-jq
+        script: .b
+    endpoints:
+      - shared
+      - second-jq
+    )#"));
+
+    THEN("only the stages feeding nothing else are fused, with at most one jq stage per chain")
+    {
+      const auto expected = std::vector<std::string>{ "shared", "first-jq", "second-jq" };
+      CHECK(get_pipeline_names(configuration) == expected);
+    }
+  }
+
+  GIVEN("a chain with a parallel stage")
+  {
+    const auto configuration = trawler::optimize_configuration(trawler::parse_configuration(R"#(
+    pipelines:
+      - name: emit
+        pipeline: emit
+        source: my-service
+        data: "{}"
+      - name: jq
+        pipeline: jq
+        source: emit
+        script: .
+        parallelism: 4
+    endpoints:
+      - jq
+    )#"));
+
+    THEN("the parallel stage is not fused")
+    {
+      const auto expected = std::vector<std::string>{ "emit", "jq" };
+      CHECK(get_pipeline_names(configuration) == expected);
+    }
+  }
+}
+
+SCENARIO("pipeline multicast")
+{
+  GIVEN("a pipeline with two consumers")
+  {
+    using trawler::ServicePacket;
+
+    auto context = trawler::make_service_context( );
+    auto subject = rxcpp::subjects::subject<ServicePacket>{ };
+    auto runs = std::make_shared<int>(0);
+    auto service = subject.get_observable( )
+                     .map([runs](const ServicePacket& packet) {
+                       ++*runs;
+                       return packet;
+                     })
+                     .as_dynamic( );
+
+    auto producer = trawler::config::emit_pipeline_t{ };
+    producer.name = "producer";
+    producer.pipeline = "emit";
+    producer.source = "my-service";
+    producer.data = "produced";
+
+    auto first = producer;
+    first.name = "first";
+    first.source = "producer";
+
+    auto second = first;
+    second.name = "second";
+
+    const auto pipelines = trawler::spawn_pipelines(
+      context, { { "my-service", service } }, { producer, first, second }, { "pipelines" });
+    REQUIRE(pipelines.size( ) == 3);
+
+    auto received = std::make_shared<int>(0);
+    auto on_next = [received](const ServicePacket&) { ++*received; };
+    auto first_subscription = pipelines[1].second.subscribe(on_next);
+    auto second_subscription = pipelines[2].second.subscribe(on_next);
+
+    WHEN("a packet passes through")
+    {
+      const auto packet = ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, std::string{ "packet" } };
+      subject.get_subscriber( ).on_next(packet);
+
+      THEN("the shared stages run once and both consumers get it")
+      {
+        CHECK(*runs == 1);
+        CHECK(*received == 2);
+      }
+    }
+
+    first_subscription.unsubscribe( );
+    second_subscription.unsubscribe( );
+  }
+}
+
+SCENARIO("fused pipelines")
+{
+  GIVEN("a chain of pure stages with map stages before and after the jq stage")
+  {
+    using trawler::ServicePacket;
+
+    const auto configuration = trawler::parse_configuration(R"#(
+    pipelines:
+      - name: emit
+        pipeline: emit
+        source: my-service
+        data: '{ "items": [ 1, 2, 3 ], "tag": "emitted" }'
+      - name: before
+        pipeline: inja
+        source: emit
+        template: '{ "items": {{ items }}, "tag": "{{ tag }}-before" }'
+      - name: jq
+        pipeline: jq
+        source: before
+        script: '.tag as $tag | .items[] | { value: ., tag: $tag }'
+      - name: after
+        pipeline: inja
+        source: jq
+        template: '{ "text": "{{ value }} {{ tag }}" }'
+      - name: last
+        pipeline: inja
+        source: after
+        template: '{{ text }}-after'
+    endpoints:
+      - last
+    )#");
+    const auto fused = trawler::optimize_configuration(configuration);
+    REQUIRE(fused.pipelines.size( ) == 1);
+
+    // Runs the pipelines on a packet, collecting what the endpoint sees
+    auto run = [](const std::vector<trawler::configuration_t::pipeline_t>& pipeline_config) {
+      auto context = trawler::make_service_context( );
+      auto subject = rxcpp::subjects::subject<ServicePacket>{ };
+      const auto pipelines = trawler::spawn_pipelines(
+        context, { { "my-service", subject.get_observable( ).as_dynamic( ) } }, pipeline_config, { "pipelines" });
+      const auto last = std::find_if(
+        begin(pipelines), end(pipelines), [](const auto& pipeline) { return pipeline.first == "last"; });
+      REQUIRE(last != end(pipelines));
+
+      auto received = std::make_shared<std::vector<std::string>>( );
+      auto subscription = last->second.subscribe(
+        [received](const ServicePacket& packet) { received->push_back(packet.get_payload_as<std::string>( )); });
+      const auto packet = ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, std::string{ "{}" } };
+      subject.get_subscriber( ).on_next(packet);
+      subscription.unsubscribe( );
+      return *received;
+    };
+
+    WHEN("a packet passes through the fused and the unfused chain")
+    {
+      const auto unfused_results = run(configuration.pipelines);
+      const auto fused_results = run(fused.pipelines);
+
+      THEN("both give the same packets")
+      {
+        const auto expected = std::vector<std::string>{
+          "1 emitted-before-after", "2 emitted-before-after", "3 emitted-before-after"
+        };
+        CHECK(unfused_results == expected);
+        CHECK(fused_results == expected);
+      }
+    }
+  }
+}
+
+SCENARIO("worker supervision")
+{
+  GIVEN("workers crashing the first time they run")
+  {
+    constexpr auto nof_workers = 2;
+    const auto directory = std::filesystem::temp_directory_path( ) / ("trawler-workers-" + std::to_string(getpid( )));
+    std::filesystem::create_directories(directory);
+
+    // Every run of a worker leaves a line in a file of its own, which tells it whether it ran before
+    auto worker = [&](std::size_t index) {
+      const auto runs = directory / std::to_string(index);
+      const auto ran_before = std::filesystem::exists(runs);
+      std::ofstream{ runs, std::ios::app } << "run\n";
+      if (!ran_before) {
+        std::abort( );
+      }
+      return 0;
+    };
+
+    WHEN("they are supervised")
+    {
+      const auto logger = trawler::Logger{ "supervisor" };
+      const auto result = trawler::supervise_workers(nof_workers, worker, logger, std::chrono::milliseconds{ 0 });
+
+      THEN("each of them is restarted once, after which all of them succeed")
+      {
+        CHECK(result == 0);
+        for (auto index = 0; index < nof_workers; ++index) {
+          std::ifstream runs{ directory / std::to_string(index) };
+          auto nof_runs = 0;
+          for (std::string line; std::getline(runs, line);) {
+            ++nof_runs;
+          }
+          CHECK(nof_runs == 2);
+        }
+      }
+    }
+
+    std::filesystem::remove_all(directory);
+  }
+
+  GIVEN("workers throwing every time they run")
+  {
+    constexpr auto nof_workers = 2;
+    constexpr auto max_fast_failures = 3;
+    const auto directory = std::filesystem::temp_directory_path( ) / ("trawler-workers-" + std::to_string(getpid( )));
+    std::filesystem::create_directories(directory);
+
+    auto worker = [&](std::size_t index) -> int {
+      std::ofstream{ directory / std::to_string(index), std::ios::app } << "run\n";
+      throw std::runtime_error{ "failed to bind" };
+    };
+
+    WHEN("they are supervised")
+    {
+      const auto logger = trawler::Logger{ "supervisor" };
+      const auto result = trawler::supervise_workers(
+        nof_workers, worker, logger, std::chrono::milliseconds{ 100 }, max_fast_failures);
+
+      THEN("each of them is given up on after failing right away a number of times in a row")
+      {
+        CHECK(result == 1);
+        for (auto index = 0; index < nof_workers; ++index) {
+          std::ifstream runs{ directory / std::to_string(index) };
+          auto nof_runs = 0;
+          for (std::string line; std::getline(runs, line);) {
+            ++nof_runs;
+          }
+          CHECK(nof_runs == max_fast_failures);
+        }
+      }
+    }
+
+    std::filesystem::remove_all(directory);
+  }
+
+  GIVEN("workers running until they are stopped, one of which stops the supervisor")
+  {
+    auto worker = [](std::size_t index) {
+      if (index == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 100 });
+        kill(getppid( ), SIGTERM);
+      }
+      for (;;) {
+        pause( );
+      }
+      return 0;
+    };
+
+    WHEN("they are supervised")
+    {
+      const auto logger = trawler::Logger{ "supervisor" };
+      const auto result = trawler::supervise_workers(2, worker, logger);
+
+      THEN("the supervisor succeeds once they have all stopped") { CHECK(result == 0); }
+    }
+  }
+
+  GIVEN("a worker waiting to be restarted and another one stopping the supervisor")
+  {
+    const auto directory = std::filesystem::temp_directory_path( ) / ("trawler-workers-" + std::to_string(getpid( )));
+    std::filesystem::create_directories(directory);
+
+    auto worker = [&](std::size_t index) {
+      std::ofstream{ directory / std::to_string(index), std::ios::app } << "run\n";
+      if (index == 0) {
+        std::abort( );
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds{ 100 });
+      kill(getppid( ), SIGTERM);
+      for (;;) {
+        pause( );
+      }
+      return 0;
+    };
+
+    WHEN("they are supervised")
+    {
+      const auto logger = trawler::Logger{ "supervisor" };
+      const auto started = std::chrono::steady_clock::now( );
+      const auto result = trawler::supervise_workers(2, worker, logger, std::chrono::seconds{ 10 });
+      const auto elapsed = std::chrono::steady_clock::now( ) - started;
+
+      THEN("the supervisor stops right away without restarting the crashed worker")
+      {
+        CHECK(result == 1);
+        CHECK(elapsed < std::chrono::seconds{ 5 });
+        std::ifstream runs{ directory / "0" };
+        auto nof_runs = 0;
+        for (std::string line; std::getline(runs, line);) {
+          ++nof_runs;
+        }
+        CHECK(nof_runs == 1);
+      }
+    }
+
+    std::filesystem::remove_all(directory);
+  }
+}
@@ -2,4 +2,33 @@
 #include <doctest.h>
 #include <trawler/pipelines/emit/emit.hpp>
 
+using namespace trawler;
+
 SCENARIO("dummy emit") {}
+
+SCENARIO("emitted payloads are shared")
+{
+  GIVEN("an emit pipeline")
+  {
+    auto emit = create_emit_pipeline("data");
+
+    WHEN("two packets pass through it")
+    {
+      const auto first = emit(ServicePacket{ ServicePacket::EStatus::CONNECTED });
+      const auto second = emit(ServicePacket{ ServicePacket::EStatus::CONNECTED });
+
+      THEN("both refer to the same payload")
+      {
+        CHECK(first.get_shared_payload( ) == second.get_shared_payload( ));
+        CHECK(first.get_payload_as<std::string>( ) == "data");
+      }
+
+      AND_WHEN("viewed as a string")
+      {
+        const auto view = first.get_payload_view<std::string>( );
+
+        THEN("no copy is made") { CHECK(view.get( ) == &std::get<std::string>(first.get_payload( ))); }
+      }
+    }
+  }
+}
@@ -1,5 +1,772 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <atomic>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
 #include <doctest.h>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <trawler/pipelines/http-client/http-client.hpp>
+#include <trawler/pipelines/http-client/scatter-gather.hpp>
+#include <vector>
 
-SCENARIO("dummy http-client") {}
+using namespace trawler;
+using namespace std::chrono_literals;
+
+namespace {
+
+namespace http = boost::beast::http;
+using tcp = boost::asio::ip::tcp;
+
+/*******************************************************************************
+ * A blocking http server accepting a fixed number of connections, each one on
+ * a thread of its own, and answering a fixed number of requests on each. It
+ * keeps track of how many requests it served at the same time. Responses can
+ * be customized before they are sent.
+ ******************************************************************************/
+class TestServer
+{
+public:
+  using customize_t =
+    std::function<void(const http::request<http::string_body>&, http::response<http::string_body>&)>;
+
+private:
+  boost::asio::io_context context;
+  tcp::acceptor acceptor{ context, { boost::asio::ip::make_address("127.0.0.1"), 0 } };
+  std::thread thread;
+  std::atomic<int> concurrent{ 0 };
+  customize_t customize;
+
+public:
+  std::atomic<int> max_concurrent{ 0 };
+
+  explicit TestServer(int nof_connections, int requests_per_connection = 1, customize_t customize = nullptr)
+    : customize{ std::move(customize) }
+  {
+    thread = std::thread{ [this, nof_connections, requests_per_connection] {
+      std::vector<std::thread> sessions;
+      for (auto n = 0; n < nof_connections; ++n) {
+        auto socket = std::make_shared<tcp::socket>(context);
+        acceptor.accept(*socket);
+        sessions.emplace_back([this, socket, requests_per_connection] {
+          boost::beast::flat_buffer buffer;
+          for (auto r = 0; r < requests_per_connection; ++r) {
+            serve(*socket, buffer);
+          }
+          boost::system::error_code ec;
+          socket->shutdown(tcp::socket::shutdown_both, ec);
+        });
+      }
+      for (auto& session : sessions) {
+        session.join( );
+      }
+    } };
+  }
+
+  ~TestServer( ) { thread.join( ); }
+
+  TestServer(const TestServer&) = delete;
+  TestServer(TestServer&&) = delete;
+  TestServer& operator=(const TestServer&) = delete;
+  TestServer& operator=(TestServer&&) = delete;
+
+  std::string port( ) const { return std::to_string(acceptor.local_endpoint( ).port( )); }
+
+  void serve(tcp::socket& socket, boost::beast::flat_buffer& buffer)
+  {
+    const auto now = ++concurrent;
+    auto max = max_concurrent.load( );
+    while (now > max && !max_concurrent.compare_exchange_weak(max, now)) {
+    }
+
+    http::request<http::string_body> request;
+    http::read(socket, buffer, request);
+
+    std::this_thread::sleep_for(50ms);
+
+    http::response<http::string_body> response{ http::status::ok, request.version( ) };
+    response.set(http::field::content_type, "application/json");
+    response.keep_alive(request.keep_alive( ));
+    response.body( ) = R"/({"target": ")/" + std::string{ request.target( ) } + R"/("})/";
+    if (customize) {
+      customize(request, response);
+    }
+    response.prepare_payload( );
+
+    --concurrent;
+    http::write(socket, response);
+  }
+};
+
+auto
+make_request(const std::string& port, const std::string& target)
+{
+  const auto payload =
+    nlohmann::json{ { "host", "127.0.0.1" }, { "port", port }, { "target", target }, { "version", "1.1" } };
+  return ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { payload } };
+}
+
+// Requests target and returns the single response it is answered with
+template<typename HttpClient>
+nlohmann::json
+request_json(const HttpClient& http_client, const std::string& port, const std::string& target)
+{
+  std::vector<ServicePacket> responses;
+  std::atomic<bool> completed{ false };
+  http_client(make_request(port, target))
+    .subscribe([&](const ServicePacket& packet) { responses.push_back(packet); }, [&]( ) { completed = true; });
+  const auto stop_time = std::chrono::steady_clock::now( ) + 10s;
+  while (!completed && std::chrono::steady_clock::now( ) < stop_time) {
+    std::this_thread::sleep_for(10ms);
+  }
+  REQUIRE(completed);
+  REQUIRE(responses.size( ) == 1);
+  return responses.front( ).get_payload_as<nlohmann::json>( );
+}
+
+template<typename Predicate>
+bool
+wait_for(Predicate predicate)
+{
+  const auto stop_time = std::chrono::steady_clock::now( ) + 10s;
+  while (!predicate( )) {
+    if (std::chrono::steady_clock::now( ) > stop_time) {
+      return false;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  return true;
+}
+}
+
+SCENARIO("asynchronous http-client")
+{
+  GIVEN("an http server and an http-client pipeline allowing two requests in flight")
+  {
+    constexpr auto nof_requests = 6;
+    TestServer server{ nof_requests };
+
+    auto context = make_service_context(2, 1);
+    auto options = http_client_options_t{ };
+    options.max_in_flight = 2;
+    auto http_client = create_http_client_pipeline(context, options);
+
+    WHEN("several requests are made at once")
+    {
+      std::mutex mutex;
+      std::vector<nlohmann::json> responses;
+      std::atomic<int> completed{ 0 };
+
+      for (auto n = 0; n < nof_requests; ++n) {
+        http_client(make_request(server.port( ), "/" + std::to_string(n)))
+          .subscribe(
+            [&](const ServicePacket& packet) {
+              std::lock_guard<std::mutex> lock{ mutex };
+              responses.push_back(packet.get_payload_as<nlohmann::json>( ));
+            },
+            [&]( ) { ++completed; });
+      }
+
+      REQUIRE(wait_for([&] { return completed == nof_requests; }));
+
+      THEN("every response is emitted with its parsed body")
+      {
+        REQUIRE(responses.size( ) == nof_requests);
+        for (const auto& response : responses) {
+          CHECK(response["headers"]["Content-Type"] == "application/json");
+          CHECK(response["body"]["target"].get<std::string>( ).size( ) == 2);
+        }
+      }
+
+      THEN("no more than two requests were in flight at a time") { CHECK(server.max_concurrent <= 2); }
+    }
+  }
+
+  GIVEN("an http-client pipeline and a port nobody listens on")
+  {
+    auto context = make_service_context( );
+    auto http_client = create_http_client_pipeline(context);
+
+    std::string port;
+    {
+      boost::asio::io_context io;
+      tcp::acceptor acceptor{ io, { boost::asio::ip::make_address("127.0.0.1"), 0 } };
+      port = std::to_string(acceptor.local_endpoint( ).port( ));
+    }
+
+    WHEN("a request is made")
+    {
+      std::atomic<int> emitted{ 0 };
+      std::atomic<bool> completed{ false };
+
+      http_client(make_request(port, "/"))
+        .subscribe([&](const ServicePacket&) { ++emitted; }, [&]( ) { completed = true; });
+
+      THEN("the packet is dropped without an error")
+      {
+        REQUIRE(wait_for([&] { return completed.load( ); }));
+        CHECK(emitted == 0);
+      }
+    }
+  }
+}
+
+SCENARIO("http-client connection pooling")
+{
+  GIVEN("an http-client pipeline with a connection pool")
+  {
+    auto context = make_service_context( );
+    auto options = http_client_options_t{ };
+    options.pool = std::make_shared<HttpConnectionPool>( );
+    auto http_client = create_http_client_pipeline(context, options);
+
+    auto request = [&](const std::string& port) {
+      std::atomic<int> emitted{ 0 };
+      std::atomic<bool> completed{ false };
+      http_client(make_request(port, "/"))
+        .subscribe([&](const ServicePacket&) { ++emitted; }, [&]( ) { completed = true; });
+      REQUIRE(wait_for([&] { return completed.load( ); }));
+      return emitted.load( );
+    };
+
+    WHEN("several requests are made one after the other to a server accepting a single connection")
+    {
+      TestServer server{ 1, 3 };
+
+      THEN("they are all answered over that connection")
+      {
+        CHECK(request(server.port( )) == 1);
+        CHECK(request(server.port( )) == 1);
+        CHECK(request(server.port( )) == 1);
+        CHECK(options.pool->idle_count( ) == 1);
+      }
+    }
+
+    WHEN("the server closes a pooled connection")
+    {
+      TestServer server{ 2, 1 };
+
+      THEN("the next request reconnects transparently")
+      {
+        CHECK(request(server.port( )) == 1);
+        CHECK(request(server.port( )) == 1);
+      }
+    }
+  }
+}
+
+SCENARIO("http-client request coalescing")
+{
+  GIVEN("an http server accepting a single request and an http-client pipeline")
+  {
+    TestServer server{ 1, 1 };
+
+    auto context = make_service_context( );
+    auto http_client = create_http_client_pipeline(context);
+
+    WHEN("several identical requests are made at once")
+    {
+      constexpr auto nof_requests = 5;
+      std::mutex mutex;
+      std::vector<ServicePacket> responses;
+      std::atomic<int> completed{ 0 };
+
+      for (auto n = 0; n < nof_requests; ++n) {
+        http_client(make_request(server.port( ), "/same"))
+          .subscribe(
+            [&](const ServicePacket& packet) {
+              std::lock_guard<std::mutex> lock{ mutex };
+              responses.push_back(packet);
+            },
+            [&]( ) { ++completed; });
+      }
+
+      REQUIRE(wait_for([&] { return completed == nof_requests; }));
+
+      THEN("they are all answered by one upstream request")
+      {
+        REQUIRE(responses.size( ) == nof_requests);
+        for (const auto& response : responses) {
+          CHECK(response.get_shared_payload( ) == responses.front( ).get_shared_payload( ));
+          CHECK(response.get_payload_as<nlohmann::json>( )["body"]["target"] == "/same");
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("http-client deadlines")
+{
+  GIVEN("an http server accepting a single request and an http-client pipeline sending one request at a time")
+  {
+    TestServer server{ 1, 1 };
+
+    auto context = make_service_context( );
+    auto options = http_client_options_t{ };
+    options.max_in_flight = 1;
+    auto http_client = create_http_client_pipeline(context, options);
+
+    WHEN("a request with a short deadline is queued behind another one")
+    {
+      std::atomic<int> responses{ 0 };
+      std::atomic<int> completed{ 0 };
+      std::atomic<int> expired{ 0 };
+      auto on_next = [&](const ServicePacket&) { ++responses; };
+      auto on_completed = [&]( ) { ++completed; };
+
+      const auto deadline = ServicePacket::make_deadline(ServicePacket::clock_t::now( ) + 10ms, [&] { ++expired; });
+      http_client(make_request(server.port( ), "/first")).subscribe(on_next, on_completed);
+      http_client(make_request(server.port( ), "/second").with_deadline(deadline)).subscribe(on_next, on_completed);
+
+      REQUIRE(wait_for([&] { return completed == 2; }));
+
+      THEN("it is expired instead of sent once its turn comes")
+      {
+        CHECK(responses == 1);
+        CHECK(expired == 1);
+      }
+    }
+  }
+}
+
+SCENARIO("http-client response cache")
+{
+  GIVEN("an http-client pipeline with a response cache")
+  {
+    auto context = make_service_context( );
+    auto options = http_client_options_t{ };
+    options.cache_bytes = 1024 * 1024;
+    auto http_client = create_http_client_pipeline(context, options);
+
+    auto request = [&](const std::string& port) { return request_json(http_client, port, "/cached"); };
+
+    WHEN("a fresh response is requested again from a server accepting a single request")
+    {
+      TestServer server{ 1, 1, [](const auto&, auto& response) {
+                          response.set(http::field::cache_control, "max-age=60");
+                        } };
+
+      THEN("both requests are answered")
+      {
+        CHECK(request(server.port( ))["body"]["target"] == "/cached");
+        CHECK(request(server.port( ))["body"]["target"] == "/cached");
+      }
+    }
+
+    WHEN("a response with an ETag is requested again")
+    {
+      std::atomic<int> not_modified{ 0 };
+      TestServer server{ 2, 1, [&](const auto& request, auto& response) {
+                          response.set(http::field::cache_control, "no-cache");
+                          response.set(http::field::etag, "\"v1\"");
+                          if (request[http::field::if_none_match] == "\"v1\"") {
+                            response.result(http::status::not_modified);
+                            response.body( ).clear( );
+                            ++not_modified;
+                          }
+                        } };
+
+      THEN("it is revalidated and the cached response is emitted")
+      {
+        const auto first = request(server.port( ));
+        const auto second = request(server.port( ));
+        CHECK(second == first);
+        CHECK(second["body"]["target"] == "/cached");
+        CHECK(not_modified == 1);
+      }
+    }
+
+    WHEN("a response is revalidated by a 304 without a Cache-Control")
+    {
+      std::atomic<int> served{ 0 };
+      TestServer server{ 2, 1, [&](const auto& request, auto& response) {
+                          ++served;
+                          response.set(http::field::etag, "\"v1\"");
+                          if (request[http::field::if_none_match] == "\"v1\"") {
+                            response.result(http::status::not_modified);
+                            response.body( ).clear( );
+                          } else {
+                            response.set(http::field::cache_control, "max-age=1");
+                          }
+                        } };
+
+      THEN("it is fresh again for as long as it was stored for")
+      {
+        request(server.port( ));
+        std::this_thread::sleep_for(1100ms);
+        request(server.port( ));
+        CHECK(served == 2);
+        CHECK(request(server.port( ))["body"]["target"] == "/cached");
+        CHECK(served == 2);
+      }
+    }
+
+    WHEN("a response is requested again while it may be served stale")
+    {
+      std::atomic<int> served{ 0 };
+      TestServer server{ 2, 1, [&](const auto&, auto& response) {
+                          const auto version = ++served;
+                          response.set(http::field::cache_control,
+                                       version == 1 ? "max-age=0, stale-while-revalidate=60" : "max-age=60");
+                          response.body( ) = R"/({"version": )/" + std::to_string(version) + "}";
+                        } };
+
+      THEN("the stale response is emitted while it is revalidated in the background")
+      {
+        CHECK(request(server.port( ))["body"]["version"] == 1);
+        CHECK(request(server.port( ))["body"]["version"] == 1);
+        CHECK(wait_for([&] { return request(server.port( ))["body"]["version"] == 2; }));
+        CHECK(served == 2);
+      }
+    }
+  }
+
+  GIVEN("an http-client pipeline with a response cache holding a single response")
+  {
+    auto context = make_service_context( );
+    auto options = http_client_options_t{ };
+    options.cache_bytes = 1536;
+    auto http_client = create_http_client_pipeline(context, options);
+
+    std::atomic<int> served{ 0 };
+    TestServer server{ 3, 1, [&](const auto& request, auto& response) {
+                        ++served;
+                        response.set(http::field::cache_control, "max-age=60");
+                        const auto padding = std::string(1024, 'x');
+                        response.body( ) = R"/({"target": ")/" + std::string{ request.target( ) } +
+                                           R"/(", "padding": ")/" + padding + R"/("})/";
+                      } };
+
+    WHEN("a second response is stored")
+    {
+      request_json(http_client, server.port( ), "/first");
+      request_json(http_client, server.port( ), "/second");
+
+      THEN("the least recently used one is evicted")
+      {
+        CHECK(request_json(http_client, server.port( ), "/second")["body"]["target"] == "/second");
+        CHECK(served == 2);
+        CHECK(request_json(http_client, server.port( ), "/first")["body"]["target"] == "/first");
+        CHECK(served == 3);
+      }
+    }
+  }
+}
+
+SCENARIO("http-client retries and hedging")
+{
+  GIVEN("an http server that is unavailable at first")
+  {
+    std::atomic<int> attempts{ 0 };
+    TestServer server{ 2, 1, [&](const auto&, auto& response) {
+                        if (++attempts == 1) {
+                          response.result(http::status::service_unavailable);
+                        }
+                      } };
+
+    WHEN("a request is made by an http-client pipeline allowing retries")
+    {
+      auto context = make_service_context( );
+      auto options = http_client_options_t{ };
+      options.retries = 2;
+      options.retry_backoff = 10ms;
+      auto http_client = create_http_client_pipeline(context, options);
+
+      std::atomic<int> emitted{ 0 };
+      std::atomic<bool> completed{ false };
+      http_client(make_request(server.port( ), "/"))
+        .subscribe([&](const ServicePacket&) { ++emitted; }, [&]( ) { completed = true; });
+
+      THEN("the request is retried and the response emitted once")
+      {
+        REQUIRE(wait_for([&] { return completed.load( ); }));
+        CHECK(emitted == 1);
+        CHECK(attempts == 2);
+      }
+    }
+  }
+
+  GIVEN("an http server that is slow to answer the first request")
+  {
+    std::atomic<int> attempts{ 0 };
+    TestServer server{ 2, 1, [&](const auto&, auto&) {
+                        if (++attempts == 1) {
+                          std::this_thread::sleep_for(1s);
+                        }
+                      } };
+
+    WHEN("a request is made by an http-client pipeline hedging requests")
+    {
+      auto context = make_service_context( );
+      auto options = http_client_options_t{ };
+      options.hedge_percentile = 95;
+      options.hedge_delay = 20ms;
+      auto http_client = create_http_client_pipeline(context, options);
+
+      std::atomic<int> emitted{ 0 };
+      std::atomic<bool> completed{ false };
+      const auto start = std::chrono::steady_clock::now( );
+      http_client(make_request(server.port( ), "/"))
+        .subscribe([&](const ServicePacket&) { ++emitted; }, [&]( ) { completed = true; });
+
+      THEN("the hedged request answers first")
+      {
+        REQUIRE(wait_for([&] { return completed.load( ); }));
+        CHECK(std::chrono::steady_clock::now( ) - start < 500ms);
+        CHECK(emitted == 1);
+        CHECK(attempts == 2);
+      }
+    }
+  }
+}
+
+SCENARIO("http-client response bodies")
+{
+  GIVEN("an http server answering with a large NDJSON body")
+  {
+    constexpr auto nof_lines = 3000;
+    TestServer server{ 1, 1, [](const auto&, auto& response) {
+                        response.set(http::field::content_type, "application/x-ndjson");
+                        response.body( ).clear( );
+                        for (auto n = 0; n < nof_lines; ++n) {
+                          response.body( ) += R"/({"n": )/" + std::to_string(n) + "}\n";
+                        }
+                      } };
+
+    WHEN("it is requested by an http-client pipeline streaming NDJSON")
+    {
+      auto context = make_service_context( );
+      auto options = http_client_options_t{ };
+      options.streaming = EHttpStreaming::NDJSON;
+      options.max_body_bytes = 1024;
+      auto http_client = create_http_client_pipeline(context, options);
+
+      std::vector<nlohmann::json> elements;
+      std::atomic<bool> completed{ false };
+      http_client(make_request(server.port( ), "/"))
+        .subscribe([&](const ServicePacket& packet) { elements.push_back(packet.get_payload_as<nlohmann::json>( )); },
+                   [&]( ) { completed = true; });
+
+      THEN("a packet is emitted per line, in order")
+      {
+        REQUIRE(wait_for([&] { return completed.load( ); }));
+        REQUIRE(elements.size( ) == nof_lines);
+        for (auto n = 0; n < nof_lines; ++n) {
+          CHECK(elements[n]["body"]["n"] == n);
+        }
+        CHECK(elements.front( )["headers"]["Content-Type"] == "application/x-ndjson");
+      }
+    }
+  }
+
+  GIVEN("an http server answering with an NDJSON line larger than allowed")
+  {
+    TestServer server{ 1, 1, [](const auto&, auto& response) {
+                        response.set(http::field::content_type, "application/x-ndjson");
+                        response.body( ) = R"/({"n": 0})/" "\n" R"/({"padding": ")/" + std::string(10240, 'x') +
+                                           R"/("})/" "\n" R"/({"n": 2})/" "\n";
+                      } };
+
+    WHEN("it is requested by an http-client pipeline streaming NDJSON")
+    {
+      auto context = make_service_context( );
+      auto options = http_client_options_t{ };
+      options.streaming = EHttpStreaming::NDJSON;
+      options.max_body_bytes = 1024;
+      auto http_client = create_http_client_pipeline(context, options);
+
+      std::vector<nlohmann::json> elements;
+      std::atomic<bool> completed{ false };
+      http_client(make_request(server.port( ), "/"))
+        .subscribe([&](const ServicePacket& packet) { elements.push_back(packet.get_payload_as<nlohmann::json>( )); },
+                   [&]( ) { completed = true; });
+
+      THEN("the stream ends at the oversized line")
+      {
+        REQUIRE(wait_for([&] { return completed.load( ); }));
+        REQUIRE(elements.size( ) == 1);
+        CHECK(elements.front( )["body"]["n"] == 0);
+      }
+    }
+  }
+
+  GIVEN("an http server answering with a JSON array")
+  {
+    TestServer server{ 1, 1, [](const auto&, auto& response) {
+                        response.body( ) = R"/([ {"a": [1, 2]}, "x,]\"}", 3 ])/";
+                      } };
+
+    WHEN("it is requested by an http-client pipeline streaming JSON arrays")
+    {
+      auto context = make_service_context( );
+      auto options = http_client_options_t{ };
+      options.streaming = EHttpStreaming::JSON_ARRAY;
+      auto http_client = create_http_client_pipeline(context, options);
+
+      std::vector<nlohmann::json> elements;
+      std::atomic<bool> completed{ false };
+      http_client(make_request(server.port( ), "/"))
+        .subscribe([&](const ServicePacket& packet) { elements.push_back(packet.get_payload_as<nlohmann::json>( )); },
+                   [&]( ) { completed = true; });
+
+      THEN("a packet is emitted per element")
+      {
+        REQUIRE(wait_for([&] { return completed.load( ); }));
+        REQUIRE(elements.size( ) == 3);
+        CHECK(elements[0]["body"] == nlohmann::json::parse(R"/({"a": [1, 2]})/"));
+        CHECK(elements[1]["body"] == "x,]\"}");
+        CHECK(elements[2]["body"] == 3);
+      }
+    }
+  }
+
+  GIVEN("an http server answering with a body larger than allowed")
+  {
+    TestServer server{ 1, 1, [](const auto&, auto& response) { response.body( ) = std::string(4096, ' ') + "{}"; } };
+
+    WHEN("it is requested by an http-client pipeline")
+    {
+      auto context = make_service_context( );
+      auto options = http_client_options_t{ };
+      options.max_body_bytes = 1024;
+      auto http_client = create_http_client_pipeline(context, options);
+
+      std::atomic<int> emitted{ 0 };
+      std::atomic<bool> completed{ false };
+      http_client(make_request(server.port( ), "/"))
+        .subscribe([&](const ServicePacket&) { ++emitted; }, [&]( ) { completed = true; });
+
+      THEN("the response is dropped")
+      {
+        REQUIRE(wait_for([&] { return completed.load( ); }));
+        CHECK(emitted == 0);
+      }
+    }
+  }
+}
+
+SCENARIO("http scatter-gather")
+{
+  GIVEN("an http server, a port nobody listens on and a scatter-gather pipeline")
+  {
+    TestServer server{ 2, 1 };
+
+    std::string closed_port;
+    {
+      boost::asio::io_context io;
+      tcp::acceptor acceptor{ io, { boost::asio::ip::make_address("127.0.0.1"), 0 } };
+      closed_port = std::to_string(acceptor.local_endpoint( ).port( ));
+    }
+
+    auto context = make_service_context( );
+    auto scatter_gather = create_http_scatter_gather_pipeline(context);
+
+    WHEN("three requests are made in one packet, one of them to the closed port")
+    {
+      const auto requests = nlohmann::json{ make_request(server.port( ), "/a").get_payload_as<nlohmann::json>( ),
+                                            make_request(closed_port, "/b").get_payload_as<nlohmann::json>( ),
+                                            make_request(server.port( ), "/c").get_payload_as<nlohmann::json>( ) };
+
+      std::vector<nlohmann::json> results;
+      std::atomic<bool> completed{ false };
+      const auto payload = nlohmann::json{ { "requests", requests } };
+      scatter_gather(ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { payload } })
+        .subscribe([&](const ServicePacket& packet) { results.push_back(packet.get_payload_as<nlohmann::json>( )); },
+                   [&]( ) { completed = true; });
+
+      THEN("a single packet merges the responses and the error")
+      {
+        REQUIRE(wait_for([&] { return completed.load( ); }));
+        REQUIRE(results.size( ) == 1);
+        const auto& result = results.front( );
+        REQUIRE(result["responses"].size( ) == 3);
+        CHECK(result["responses"][0]["body"]["target"] == "/a");
+        CHECK(result["responses"][1].is_null( ));
+        CHECK(result["responses"][2]["body"]["target"] == "/c");
+        REQUIRE(result["errors"].size( ) == 1);
+        CHECK(result["errors"][0]["index"] == 1);
+      }
+    }
+  }
+
+  GIVEN("an http server slow to answer and a scatter-gather pipeline with a short timeout")
+  {
+    TestServer server{ 1, 1, [](const auto&, auto&) { std::this_thread::sleep_for(1s); } };
+
+    auto context = make_service_context( );
+    auto options = http_scatter_gather_options_t{ };
+    options.timeout = 100ms;
+    auto scatter_gather = create_http_scatter_gather_pipeline(context, options);
+
+    WHEN("a request is made")
+    {
+      const auto requests = nlohmann::json{ make_request(server.port( ), "/").get_payload_as<nlohmann::json>( ) };
+
+      std::vector<nlohmann::json> results;
+      std::atomic<bool> completed{ false };
+      const auto start = std::chrono::steady_clock::now( );
+      scatter_gather(ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { requests } })
+        .subscribe([&](const ServicePacket& packet) { results.push_back(packet.get_payload_as<nlohmann::json>( )); },
+                   [&]( ) { completed = true; });
+
+      THEN("it is reported as timed out without waiting for the server")
+      {
+        REQUIRE(wait_for([&] { return completed.load( ); }));
+        CHECK(std::chrono::steady_clock::now( ) - start < 500ms);
+        REQUIRE(results.size( ) == 1);
+        CHECK(results.front( )["responses"][0].is_null( ));
+        CHECK(results.front( )["errors"][0]["error"] == "timed out");
+      }
+    }
+  }
+
+  GIVEN("a slow and a fast http server and a scatter-gather pipeline making one call at a time")
+  {
+    std::atomic<int> queued_calls_made{ 0 };
+    TestServer slow_server{ 1, 1, [](const auto&, auto&) { std::this_thread::sleep_for(1s); } };
+    TestServer fast_server{ 2, 1, [&](const auto& request, auto&) {
+                             if (request.target( ) == "/queued") {
+                               ++queued_calls_made;
+                             }
+                           } };
+
+    auto context = make_service_context( );
+    auto options = http_scatter_gather_options_t{ };
+    options.timeout = 300ms;
+    options.client.max_in_flight = 1;
+    auto scatter_gather = create_http_scatter_gather_pipeline(context, options);
+
+    auto gather = [&](const nlohmann::json& requests) {
+      std::vector<nlohmann::json> results;
+      std::atomic<bool> completed{ false };
+      scatter_gather(ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { requests } })
+        .subscribe([&](const ServicePacket& packet) { results.push_back(packet.get_payload_as<nlohmann::json>( )); },
+                   [&]( ) { completed = true; });
+      REQUIRE(wait_for([&] { return completed.load( ); }));
+      REQUIRE(results.size( ) == 1);
+      return results.front( );
+    };
+
+    auto fast_request = [&](const std::string& target) {
+      return make_request(fast_server.port( ), target).get_payload_as<nlohmann::json>( );
+    };
+
+    WHEN("the calls queued behind a slow one time out")
+    {
+      const auto slow_request = make_request(slow_server.port( ), "/").get_payload_as<nlohmann::json>( );
+      const auto timed_out = gather(nlohmann::json{ slow_request, fast_request("/queued"), fast_request("/queued") });
+      std::this_thread::sleep_for(1200ms);
+
+      THEN("they are never made")
+      {
+        CHECK(timed_out["errors"].size( ) == 3);
+        const auto result = gather(nlohmann::json{ fast_request("/a"), fast_request("/b") });
+        CHECK(result["responses"][0]["body"]["target"] == "/a");
+        CHECK(result["responses"][1]["body"]["target"] == "/b");
+        CHECK(queued_calls_made == 0);
+      }
+    }
+  }
+}
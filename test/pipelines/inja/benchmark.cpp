@@ -0,0 +1,79 @@
+#include <chrono>
+#include <inja.hpp>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <trawler/pipelines/inja/inja.hpp>
+
+using namespace trawler;
+
+namespace {
+
+constexpr auto iterations = 20000;
+
+// The dashboard template of examples/bitcoin.yaml
+const auto tmplate = std::string{ R"/(
+  <table>
+    <tr>
+      <th>Bid</th>
+      <th>Bid Size</th>
+      <th>Ask</th>
+      <th>Ask Size</th>
+      <th>Daily Change</th>
+      <th>Daily Change (%)</th>
+      <th>Last Price</th>
+      <th>Volume</th>
+      <th>High</th>
+      <th>Low</th>
+    </tr>
+    <tr>
+      <th>{{ source/bid               }}</th>
+      <th>{{ source/bid_size          }}</th>
+      <th>{{ source/ask               }}</th>
+      <th>{{ source/ask_size          }}</th>
+      <th>{{ source/daily_change      }}</th>
+      <th>{{ source/daily_change_perc }}</th>
+      <th>{{ source/last_price        }}</th>
+      <th>{{ source/volume            }}</th>
+      <th>{{ source/high              }}</th>
+      <th>{{ source/low               }}</th>
+    </tr>
+  </table>
+)/" };
+
+const auto data = nlohmann::json::parse(R"/({
+  "source": {
+    "bid": 6590.1, "bid_size": 33.59, "ask": 6590.2, "ask_size": 45.18, "daily_change": -58.5,
+    "daily_change_perc": -0.0088, "last_price": 6590.1, "volume": 15813.74, "high": 6697.9, "low": 6570
+  },
+  "trigger": {}
+})/");
+
+template<typename Fn>
+void
+measure(const std::string& name, Fn fn)
+{
+  const auto start = std::chrono::steady_clock::now( );
+  for (auto i = 0; i < iterations; ++i) {
+    fn( );
+  }
+  const auto elapsed = std::chrono::steady_clock::now( ) - start;
+  const auto seconds = std::chrono::duration<double>(elapsed).count( );
+  std::cout << name << ": " << static_cast<long>(iterations / seconds) << " renders/s\n";
+}
+}
+
+int
+main( )
+{
+  std::size_t total = 0;
+
+  // What the inja pipeline used to do for every packet
+  measure("parse and render", [&] { total += inja::render(tmplate, data).size( ); });
+
+  auto inja = create_inja_pipeline(tmplate);
+  const auto packet = ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { data } };
+  measure("precompiled template", [&] { total += inja(packet).get_payload_view<std::string>( )->size( ); });
+
+  return total > 0 ? 0 : 1;
+}
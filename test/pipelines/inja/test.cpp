@@ -0,0 +1,27 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#include <trawler/pipelines/inja/inja.hpp>
+
+using namespace trawler;
+
+SCENARIO("inja rendering")
+{
+  GIVEN("an inja pipeline")
+  {
+    auto inja = create_inja_pipeline("<p>{{ source/bid }} / {{ source/ask }}</p>");
+
+    WHEN("several packets are rendered with it")
+    {
+      const auto first = inja(ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION,
+                                             { nlohmann::json::parse(R"/({"source": {"bid": 1, "ask": 2}})/") } });
+      const auto second = inja(ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION,
+                                              { std::string{ R"/({"source": {"bid": 3, "ask": 4}})/" } } });
+
+      THEN("every packet is rendered with its own data")
+      {
+        CHECK(first.get_payload_as<std::string>( ) == "<p>1 / 2</p>");
+        CHECK(second.get_payload_as<std::string>( ) == "<p>3 / 4</p>");
+      }
+    }
+  }
+}
@@ -0,0 +1,103 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <rxcpp/rx.hpp>
+#include <string>
+#include <trawler/pipelines/jq/jq.hpp>
+
+extern "C"
+{
+#include <jq.h>
+}
+
+using namespace trawler;
+
+namespace {
+
+constexpr auto iterations = 100000;
+
+const auto script = std::string{ R"/(
+  . | arrays | .[1] | arrays | {
+    bid: .[0], bid_size: .[1], ask: .[2], ask_size: .[3], daily_change: .[4],
+    daily_change_perc: .[5], last_price: .[6], volume: .[7], high: .[8], low: .[9]
+  })/" };
+
+const auto ticker = nlohmann::json::parse(
+  R"/([12, [6590.1, 33.59, 6590.2, 45.18, -58.5, -0.0088, 6590.1, 15813.74, 6697.9, 6570]])/");
+
+auto
+make_packet( )
+{
+  return ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { ticker } };
+}
+
+template<typename Fn>
+void
+measure(const std::string& name, Fn fn)
+{
+  const auto start = std::chrono::steady_clock::now( );
+  for (auto i = 0; i < iterations; ++i) {
+    fn( );
+  }
+  const auto elapsed = std::chrono::steady_clock::now( ) - start;
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count( );
+  std::cout << name << ": " << ns / iterations << " ns/packet\n";
+}
+
+/*******************************************************************************
+ * The textual round trip the jq pipeline used to do: dump the payload, parse it
+ * with jv_parser, dump every result with jv_dump_string and parse it again.
+ ******************************************************************************/
+auto
+make_text_round_trip( )
+{
+  auto deleter = [](auto* p) { jq_teardown(&p); };
+  auto jq = std::shared_ptr<jq_state>(jq_init( ), deleter);
+  if (!jq_compile_args(jq.get( ), script.c_str( ), jv_array( ))) {
+    throw std::runtime_error{ "Failed to compile jq script" };
+  }
+
+  return [jq](const ServicePacket& input, std::vector<ServicePacket>& output) {
+    auto parser = std::shared_ptr<jv_parser>(jv_parser_new(0), [](auto* p) { jv_parser_free(p); });
+    const auto payload = input.get_payload_view<std::string>( );
+    jv_parser_set_buf(parser.get( ), payload->c_str( ), payload->size( ), 0);
+
+    for (auto value = jv_parser_next(parser.get( )); jv_is_valid(value); value = jv_parser_next(parser.get( ))) {
+      jq_start(jq.get( ), value, 0);
+      for (auto result = jq_next(jq.get( )); jv_is_valid(result); result = jq_next(jq.get( ))) {
+        auto dump = jv_dump_string(result, 0);
+        auto json = nlohmann::json::parse(jv_string_value(dump));
+        jv_free(dump);
+        output.push_back(input.with_payload({ std::move(json) }));
+      }
+    }
+  };
+}
+}
+
+int
+main( )
+{
+  std::vector<ServicePacket> output;
+  output.reserve(iterations);
+
+  auto text_round_trip = make_text_round_trip( );
+  measure("text round trip", [&] { text_round_trip(make_packet( ), output); });
+
+  output.clear( );
+
+  auto jq = create_jq_pipeline(script, { "jq" }, EJqBackend::INTERPRETER);
+  measure("structural bridge", [&] {
+    jq(make_packet( )).subscribe([&](const ServicePacket& packet) { output.push_back(packet); });
+  });
+
+  output.clear( );
+
+  auto native = create_jq_pipeline(script, { "jq" }, EJqBackend::AUTO);
+  measure("native evaluation", [&] {
+    native(make_packet( )).subscribe([&](const ServicePacket& packet) { output.push_back(packet); });
+  });
+
+  return output.size( ) == iterations ? 0 : 1;
+}
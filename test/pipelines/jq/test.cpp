@@ -1,5 +1,7 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest.h>
+#include <mutex>
+#include <thread>
 #include <trawler/pipelines/jq/jq.hpp>
 
 static auto i = 0;
@@ -46,3 +48,188 @@ SCENARIO("dummy jq")
     }
   }
 }
+
+SCENARIO("jq on json payloads")
+{
+  GIVEN("a json payload and a jq pipeline")
+  {
+    const auto payload = nlohmann::json::parse(R"/({
+      "string": "vålue",
+      "integer": 42,
+      "float": 1.5,
+      "bool": true,
+      "null": null,
+      "array": [1, "two", [3], {"four": 4}],
+      "object": {"nested": {"key": false}}
+    })/");
+
+    auto run = [&](const std::string& script) {
+      std::vector<nlohmann::json> results;
+      rxcpp::observable<>::just(ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { payload } })
+        .flat_map(create_jq_pipeline(script, "jq_" + std::to_string(i++)))
+        .subscribe([&](auto s) { results.push_back(s.template get_payload_as<nlohmann::json>( )); });
+      return results;
+    };
+
+    WHEN("the identity filter is applied")
+    {
+      const auto results = run(".");
+
+      THEN("the document survives the round trip unchanged")
+      {
+        REQUIRE(results.size( ) == 1);
+        CHECK(results[0] == payload);
+        CHECK(results[0]["integer"].is_number_integer( ));
+        CHECK(results[0]["float"].is_number_float( ));
+      }
+    }
+
+    WHEN("a filter builds new values")
+    {
+      const auto results = run("{sum: (.integer + .float), items: .array | length, key: .object.nested.key}");
+
+      THEN("the result is converted back structurally")
+      {
+        REQUIRE(results.size( ) == 1);
+        CHECK(results[0] == nlohmann::json::parse(R"/({"sum": 43.5, "items": 4, "key": false})/"));
+      }
+    }
+  }
+}
+
+SCENARIO("jq from several threads")
+{
+  GIVEN("a jq pipeline shared by several threads")
+  {
+    auto jq = create_jq_pipeline("{value: (.key * 2)}", "jq_" + std::to_string(i++));
+    constexpr auto nof_threads = 8;
+    constexpr auto nof_packets = 1000;
+
+    WHEN("every thread runs packets through it at the same time")
+    {
+      std::mutex mutex;
+      std::vector<long> results;
+      std::vector<std::thread> threads;
+
+      for (auto t = 0; t < nof_threads; ++t) {
+        threads.emplace_back([&] {
+          for (auto n = 0; n < nof_packets; ++n) {
+            const auto payload = nlohmann::json{ { "key", n } };
+            const auto packet = ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { payload } };
+            jq(packet).subscribe([&](auto s) {
+              std::lock_guard<std::mutex> lock{ mutex };
+              results.push_back(s.template get_payload_as<nlohmann::json>( )["value"].template get<long>( ));
+            });
+          }
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join( );
+      }
+
+      THEN("every packet is processed correctly")
+      {
+        REQUIRE(results.size( ) == nof_threads * nof_packets);
+        long sum = 0;
+        for (auto value : results) {
+          sum += value;
+        }
+        CHECK(sum == nof_threads * nof_packets * (nof_packets - 1));
+      }
+    }
+  }
+}
+
+SCENARIO("native jq evaluation")
+{
+  GIVEN("scripts within the natively supported subset and a range of inputs")
+  {
+    const auto scripts = std::vector<std::string>{
+      ".",
+      ".key",
+      ".\"key\"",
+      ".[\"key\"]",
+      ".nested.deep",
+      ".[1]",
+      ".[-1]",
+      ".[1][0]",
+      ".[7]",
+      ".key, .other",
+      "[.key, .other]",
+      "[]",
+      "{}",
+      "{key, \"other\", value: .key, const: 42, list: [.key]}",
+      "{value: .missing | arrays}",
+      "select(.key)",
+      "select(. | contains({\"method\": \"GET\"}))",
+      "contains([1])",
+      "contains(\"al\")",
+      ". | not",
+      "length",
+      "empty, 1, 2.5, 1e3, \"text\", true, false, null",
+      "arrays, objects, iterables, scalars, booleans, numbers, strings, nulls, values",
+      "# a comment\n. | arrays | .[1] | arrays | {bid: .[0], ask: .[2], low: .[9]}",
+    };
+
+    const auto inputs = std::vector<std::string>{
+      "null",
+      "true",
+      "-3.5",
+      "4.0",
+      "\"value\"",
+      R"/({"key": "value", "other": [1, 2], "nested": {"deep": 1.0}})/",
+      R"/({"method": "GET", "target": "/"})/",
+      R"/({"method": "POST"})/",
+      R"/([12, [6590.1, 33.59, 6590.2, 45.18, -58.5, -0.0088, 6590.1, 15813.74, 6697.9, 6570]])/",
+      R"/([1, 2, 3])/",
+    };
+
+    auto run = [](const std::string& script, EJqBackend backend, const nlohmann::json& payload) {
+      std::vector<nlohmann::json> results;
+      create_jq_pipeline(script, "jq_" + std::to_string(i++), backend)(
+        ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { payload } })
+        .subscribe([&](auto s) { results.push_back(s.template get_payload_as<nlohmann::json>( )); });
+      return results;
+    };
+
+    WHEN("the scripts are compiled natively")
+    {
+      THEN("none of them is left to libjq")
+      {
+        for (const auto& script : scripts) {
+          CAPTURE(script);
+          CHECK_NOTHROW(create_jq_pipeline(script, "jq_" + std::to_string(i++), EJqBackend::NATIVE));
+        }
+      }
+    }
+
+    WHEN("a script outside of the subset is compiled natively")
+    {
+      THEN("it is refused")
+      {
+        CHECK_THROWS(create_jq_pipeline("map(. + 1)", "jq_" + std::to_string(i++), EJqBackend::NATIVE));
+      }
+    }
+
+    WHEN("each script is run on each input by both backends")
+    {
+      THEN("the results are identical")
+      {
+        for (const auto& script : scripts) {
+          for (const auto& input : inputs) {
+            CAPTURE(script);
+            CAPTURE(input);
+            const auto payload = nlohmann::json::parse(input);
+            const auto native = run(script, EJqBackend::NATIVE, payload);
+            const auto interpreted = run(script, EJqBackend::INTERPRETER, payload);
+            REQUIRE(native.size( ) == interpreted.size( ));
+            for (std::size_t n = 0; n < native.size( ); ++n) {
+              CHECK(native[n] == interpreted[n]);
+              CHECK(native[n].type( ) == interpreted[n].type( ));
+            }
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <rxcpp/rx.hpp>
+#include <stdexcept>
+#include <string>
+#include <trawler/services/dataflow.hpp>
+#include <trawler/services/service-packet.hpp>
+
+using namespace trawler;
+
+namespace {
+
+constexpr auto nof_packets = 1000000;
+constexpr auto nof_stages = 4;
+
+using observable_t = rxcpp::observable<ServicePacket>;
+
+const auto payload = ServicePacket::make_payload(std::string{ "payload" });
+
+bool
+accept(const ServicePacket& packet)
+{
+  return packet.get_status( ) == ServicePacket::EStatus::DATA_TRANSMISSION && !packet.is_expired( );
+}
+
+ServicePacket
+transform(const ServicePacket& packet)
+{
+  return packet.with_shared_payload(payload);
+}
+
+/*******************************************************************************
+ * Pushes nof_packets packets into the chain built on top of subject by
+ * make_chain and returns the number of packets per second coming out of it.
+ ******************************************************************************/
+template<typename MakeChain>
+double
+measure(MakeChain make_chain)
+{
+  auto subject = rxcpp::subjects::subject<ServicePacket>{ };
+  auto received = std::size_t{ 0 };
+  auto subscription = make_chain(subject.get_observable( ).as_dynamic( )).subscribe([&](const ServicePacket&) {
+    ++received;
+  });
+
+  const auto packet = ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, std::string{ "input" } };
+  const auto subscriber = subject.get_subscriber( );
+  const auto start = std::chrono::steady_clock::now( );
+  for (auto i = 0; i < nof_packets; ++i) {
+    subscriber.on_next(packet);
+  }
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now( ) - start).count( );
+  subscription.unsubscribe( );
+
+  if (received != static_cast<std::size_t>(nof_packets)) {
+    throw std::runtime_error{ "lost packets" };
+  }
+  return nof_packets / elapsed;
+}
+
+// Every stage the way spawn_pipelines used to build it: filtered, transformed, erased and multicast
+observable_t
+make_rxcpp_map_chain(observable_t source)
+{
+  for (auto i = 0; i < nof_stages; ++i) {
+    source = source.filter(accept).map(transform).as_dynamic( ).publish( ).ref_count( ).as_dynamic( );
+  }
+  return source;
+}
+
+// Like the jq stage used to, every stage creates an observable of its results per packet
+observable_t
+make_rxcpp_flat_map_chain(observable_t source)
+{
+  auto stage = [](const ServicePacket& packet) {
+    return rxcpp::observable<>::create<ServicePacket>([packet](auto subscriber) {
+      subscriber.on_next(transform(packet));
+      subscriber.on_completed( );
+    });
+  };
+  for (auto i = 0; i < nof_stages; ++i) {
+    source = source.filter(accept).flat_map(stage).as_dynamic( ).publish( ).ref_count( ).as_dynamic( );
+  }
+  return source;
+}
+
+observable_t
+make_dataflow_chain(observable_t source)
+{
+  auto root = std::make_shared<DataflowSource>(std::move(source));
+  auto outputs = root->get_outputs( );
+  for (auto i = 0; i < nof_stages; ++i) {
+    auto node = make_dataflow_node([](const ServicePacket& packet, PacketSink& sink) {
+      if (accept(packet)) {
+        sink.push(transform(packet));
+      }
+    });
+    outputs->connect(node);
+    outputs = node->get_outputs( );
+  }
+  return make_dataflow_observable(root, outputs);
+}
+}
+
+int
+main( )
+{
+  std::cout << nof_stages << " stages\n";
+  std::cout << "rxcpp map chain:      " << measure(make_rxcpp_map_chain) << " packets/s\n";
+  std::cout << "rxcpp flat_map chain: " << measure(make_rxcpp_flat_map_chain) << " packets/s\n";
+  std::cout << "dataflow chain:       " << measure(make_dataflow_chain) << " packets/s\n";
+  return 0;
+}
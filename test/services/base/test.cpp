@@ -0,0 +1,476 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <doctest.h>
+#include <mutex>
+#include <thread>
+#include <trawler/services/dataflow.hpp>
+#include <trawler/services/service-context.hpp>
+#include <trawler/services/service-packet.hpp>
+#include <vector>
+
+using namespace trawler;
+
+SCENARIO("payload memoization")
+{
+  GIVEN("a packet with a string payload")
+  {
+    const auto payload = std::string{ R"/({"key": "value"})/" };
+    const auto packet = ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { payload } };
+
+    WHEN("the json view is requested from several threads")
+    {
+      std::vector<const nlohmann::json*> views(8);
+      std::vector<std::thread> threads;
+      for (auto i = 0U; i < views.size( ); ++i) {
+        threads.emplace_back([&, i] { views[i] = packet.get_payload_view<nlohmann::json>( ).get( ); });
+      }
+      for (auto& thread : threads) {
+        thread.join( );
+      }
+
+      THEN("the payload is parsed only once")
+      {
+        for (const auto* view : views) {
+          CHECK(view == views.front( ));
+        }
+        CHECK((*views.front( ))["key"] == "value");
+      }
+
+      AND_THEN("packets derived from it share the parsed payload")
+      {
+        const auto copy = packet.with_shared_payload(packet.get_shared_payload( ));
+        CHECK(copy.get_payload_view<nlohmann::json>( ).get( ) == views.front( ));
+      }
+    }
+  }
+
+  GIVEN("a packet with a json payload")
+  {
+    const auto packet = ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { nlohmann::json{ { "key", 1 } } } };
+
+    THEN("the payload is dumped only once")
+    {
+      const auto first = packet.get_payload_view<std::string>( );
+      const auto second = packet.get_payload_view<std::string>( );
+      CHECK(first.get( ) == second.get( ));
+      CHECK(*first == R"/({"key":1})/");
+    }
+  }
+
+  GIVEN("a packet with an invalid json string")
+  {
+    const auto packet = ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { std::string{ "{" } } };
+
+    THEN("every attempt to parse it fails")
+    {
+      CHECK_THROWS(packet.get_payload_view<nlohmann::json>( ));
+      CHECK_THROWS(packet.get_payload_view<nlohmann::json>( ));
+    }
+  }
+}
+
+SCENARIO("packet deadlines")
+{
+  GIVEN("a packet with a deadline")
+  {
+    auto expired = 0;
+    const auto now = ServicePacket::clock_t::now( );
+    const auto packet = ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, { std::string{ "a" } } };
+
+    WHEN("the deadline is in the future")
+    {
+      const auto deadline = ServicePacket::make_deadline(now + std::chrono::hours{ 1 }, [&] { ++expired; });
+      const auto with_deadline = packet.with_deadline(deadline);
+
+      THEN("the packet is not expired") { CHECK_FALSE(with_deadline.is_expired( )); }
+
+      AND_THEN("packets derived from it carry the deadline")
+      {
+        const auto derived = with_deadline.with_payload({ std::string{ "b" } });
+        CHECK(derived.get_deadline( ) == deadline);
+      }
+    }
+
+    WHEN("the deadline has passed")
+    {
+      const auto with_deadline = packet.with_deadline(ServicePacket::make_deadline(now, [&] { ++expired; }));
+
+      THEN("the packet is expired") { CHECK(with_deadline.is_expired( )); }
+
+      AND_THEN("expiring it tells whoever is waiting for it")
+      {
+        with_deadline.with_payload({ std::string{ "b" } }).expire( );
+        CHECK(expired == 1);
+      }
+    }
+
+    WHEN("there is no deadline")
+    {
+      THEN("the packet never expires")
+      {
+        CHECK_FALSE(packet.is_expired( ));
+        packet.expire( );
+        CHECK(expired == 0);
+      }
+    }
+  }
+}
+
+SCENARIO("session sharding")
+{
+  GIVEN("a service context with shared session threads")
+  {
+    auto context = make_service_context(3, 1);
+
+    THEN("every connection is assigned to the session context")
+    {
+      CHECK(context->get_nof_session_shards( ) == 1);
+      CHECK(&context->get_session_shard( ) == &context->get_session_context( ));
+      CHECK(&context->get_session_shard( ) == &context->get_session_context( ));
+    }
+  }
+
+  GIVEN("a service context with sharded session threads")
+  {
+    auto context = make_service_context(3, 1, ESessionThreading::SHARDED);
+
+    THEN("connections take turns between the shards")
+    {
+      REQUIRE(context->get_nof_session_shards( ) == 3);
+      auto* first = &context->get_session_shard( );
+      auto* second = &context->get_session_shard( );
+      auto* third = &context->get_session_shard( );
+      CHECK(first != second);
+      CHECK(second != third);
+      CHECK(first != third);
+      CHECK(&context->get_session_shard( ) == first);
+    }
+
+    AND_THEN("a connection runs on the shard it was created on")
+    {
+      auto& shard = context->get_session_shard( );
+      auto socket = boost::asio::ip::tcp::socket{ shard };
+      CHECK(&get_io_context(socket) == &shard);
+    }
+  }
+}
+
+SCENARIO("resolver cache")
+{
+  GIVEN("a service context")
+  {
+    auto context = make_service_context( );
+    auto& cache = context->get_resolver_cache( );
+
+    auto resolve = [&](const std::string& host, int nof_requests) {
+      std::mutex mutex;
+      std::condition_variable done;
+      std::vector<ResolverCache::error_t> errors;
+
+      for (auto n = 0; n < nof_requests; ++n) {
+        cache.async_resolve(host, "80", [&](auto ec, auto) {
+          std::lock_guard<std::mutex> lock{ mutex };
+          errors.push_back(ec);
+          done.notify_one( );
+        });
+      }
+
+      std::unique_lock<std::mutex> lock{ mutex };
+      done.wait(lock, [&] { return errors.size( ) == static_cast<std::size_t>(nof_requests); });
+      return errors;
+    };
+
+    WHEN("a name is resolved by many at once and then again")
+    {
+      const auto first = resolve("localhost", 16);
+      const auto second = resolve("localhost", 16);
+
+      THEN("a single lookup serves them all")
+      {
+        CHECK(cache.lookups( ) == 1);
+        for (const auto& ec : first) {
+          CHECK(!ec);
+        }
+        for (const auto& ec : second) {
+          CHECK(!ec);
+        }
+      }
+    }
+
+    WHEN("a name fails to resolve")
+    {
+      const auto first = resolve("does-not-exist.invalid", 1);
+      const auto second = resolve("does-not-exist.invalid", 1);
+
+      THEN("the failure is cached too")
+      {
+        CHECK(cache.lookups( ) == 1);
+        CHECK(first.front( ));
+        CHECK(second.front( ));
+      }
+    }
+
+    WHEN("the ttl has passed")
+    {
+      cache.set_ttl(std::chrono::seconds{ 0 }, std::chrono::seconds{ 0 });
+      resolve("localhost", 1);
+      resolve("localhost", 1);
+
+      THEN("the name is looked up again") { CHECK(cache.lookups( ) == 2); }
+    }
+  }
+}
+
+SCENARIO("dataflow runtime")
+{
+  GIVEN("an observable feeding a chain of dataflow nodes")
+  {
+    auto subject = rxcpp::subjects::subject<ServicePacket>{ };
+    auto subscriptions = std::make_shared<int>(0);
+    auto upstream = rxcpp::observable<>::create<ServicePacket>([=](rxcpp::subscriber<ServicePacket> subscriber) {
+      ++*subscriptions;
+      subject.get_observable( ).subscribe(subscriber);
+    });
+
+    auto source = std::make_shared<DataflowSource>(upstream);
+    auto twice = make_dataflow_node([](const ServicePacket& packet, PacketSink& outputs) {
+      outputs.push(packet);
+      outputs.push(packet);
+    });
+    auto failing = make_dataflow_node([](const ServicePacket& packet, PacketSink& outputs) {
+      if (packet.get_payload_as<std::string>( ) == "fail") {
+        throw std::runtime_error{ "failing stage" };
+      }
+      outputs.push(packet);
+    });
+    source->get_outputs( )->connect(twice);
+    twice->get_outputs( )->connect(failing);
+    auto output = make_dataflow_observable(source, failing->get_outputs( ));
+
+    auto received = std::make_shared<int>(0);
+    auto errors = std::make_shared<int>(0);
+    auto on_next = [received](const ServicePacket&) { ++*received; };
+    auto on_error = [errors](std::exception_ptr) { ++*errors; };
+    auto first = output.subscribe(on_next, on_error);
+    auto second = output.subscribe(on_next, on_error);
+
+    auto push = [&](std::string payload) {
+      subject.get_subscriber( ).on_next(ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, std::move(payload) });
+    };
+
+    WHEN("a packet is pushed")
+    {
+      push("ok");
+
+      THEN("the upstream is subscribed once and every subscriber gets every result")
+      {
+        CHECK(*subscriptions == 1);
+        CHECK(*received == 4);
+      }
+    }
+
+    WHEN("a stage throws")
+    {
+      push("fail");
+
+      THEN("everything downstream of it fails once") { CHECK(*errors == 2); }
+    }
+
+    WHEN("all subscribers leave")
+    {
+      first.unsubscribe( );
+      second.unsubscribe( );
+
+      THEN("the upstream is unsubscribed from") { CHECK_FALSE(subject.has_observers( )); }
+    }
+
+    WHEN("a subscriber that already left subscribes")
+    {
+      auto left = rxcpp::composite_subscription{ };
+      left.unsubscribe( );
+      output.subscribe(left, on_next, on_error);
+      push("ok");
+
+      THEN("the others keep getting every result") { CHECK(*received == 4); }
+    }
+
+    first.unsubscribe( );
+    second.unsubscribe( );
+  }
+}
+
+namespace {
+
+// Collects what is pushed to it, noting whether a push or the completion ever ran into a push from another thread
+class Collector final : public PacketSink
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::string> results;
+  bool completed = false;
+  std::atomic<bool> is_pushing{ false };
+  std::atomic<bool> overlapped{ false };
+
+public:
+  void push(const ServicePacket& packet) override
+  {
+    if (is_pushing.exchange(true)) {
+      overlapped = true;
+    }
+    // Slow enough for results emitted at about the same time to run into each other
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 2 });
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      results.push_back(packet.get_payload_as<std::string>( ));
+    }
+    is_pushing = false;
+  }
+
+  void fail(std::exception_ptr /*error*/) override {}
+
+  void complete( ) override
+  {
+    if (is_pushing) {
+      overlapped = true;
+    }
+    std::lock_guard<std::mutex> lock{ mutex };
+    completed = true;
+    cv.notify_all( );
+  }
+
+  bool has_overlapped( ) const { return overlapped; }
+
+  std::vector<std::string> wait( )
+  {
+    std::unique_lock<std::mutex> lock{ mutex };
+    cv.wait(lock, [this] { return completed; });
+    return results;
+  }
+};
+}
+
+SCENARIO("parallel dataflow nodes")
+{
+  GIVEN("a stage finishing later packets sooner, run on four threads")
+  {
+    boost::asio::io_context context;
+    auto guard = boost::asio::make_work_guard(context);
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 4; ++i) {
+      threads.emplace_back([&] { context.run( ); });
+    }
+
+    // Packets carry their index and a key, shared by the packets with an even index and by those with an odd one
+    constexpr auto nof_packets = 8;
+    auto make_payload = [](int index) {
+      return nlohmann::json{ { "index", index }, { "key", index % 2 == 0 ? "even" : "odd" } }.dump( );
+    };
+    auto get_index = [](const std::string& payload) { return nlohmann::json::parse(payload)["index"].get<int>( ); };
+
+    auto stage = [](const ServicePacket& packet, PacketSink& outputs) {
+      const auto index = packet.get_payload_view<nlohmann::json>( )->at("index").get<int>( );
+      std::this_thread::sleep_for(std::chrono::milliseconds{ 5 * (nof_packets - index) });
+      outputs.push(packet);
+    };
+
+    auto run = [&](bool ordered, ParallelNode::partition_t partition = nullptr) {
+      auto node = std::make_shared<ParallelNode>(context, 4, ordered, make_parallel_task(stage), std::move(partition));
+      auto collector = std::make_shared<Collector>( );
+      node->get_outputs( )->connect(collector);
+      for (auto i = 0; i < nof_packets; ++i) {
+        node->push(ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, make_payload(i) });
+      }
+      node->complete( );
+      return collector;
+    };
+
+    auto expected = std::vector<std::string>{ };
+    for (auto i = 0; i < nof_packets; ++i) {
+      expected.push_back(make_payload(i));
+    }
+
+    WHEN("the node is ordered")
+    {
+      const auto collector = run(true);
+      const auto results = collector->wait( );
+
+      THEN("the results come out in the order of the packets, one at a time")
+      {
+        CHECK(results == expected);
+        CHECK_FALSE(collector->has_overlapped( ));
+      }
+    }
+
+    WHEN("the node is unordered")
+    {
+      const auto collector = run(false);
+      auto results = collector->wait( );
+
+      THEN("every result comes out as soon as it is done, one at a time")
+      {
+        CHECK_FALSE(collector->has_overlapped( ));
+        CHECK(results != expected);
+        std::sort(
+          begin(results), end(results), [&](const auto& a, const auto& b) { return get_index(a) < get_index(b); });
+        CHECK(results == expected);
+      }
+    }
+
+    WHEN("the node is partitioned on the key")
+    {
+      const auto collector = run(false, make_json_partition("/key"));
+      const auto results = collector->wait( );
+
+      THEN("the packets of every key come out in order")
+      {
+        auto even = std::vector<int>{ };
+        auto odd = std::vector<int>{ };
+        for (const auto& result : results) {
+          const auto index = get_index(result);
+          (index % 2 == 0 ? even : odd).push_back(index);
+        }
+        const auto expected_even = std::vector<int>{ 0, 2, 4, 6 };
+        const auto expected_odd = std::vector<int>{ 1, 3, 5, 7 };
+        CHECK(even == expected_even);
+        CHECK(odd == expected_odd);
+        CHECK_FALSE(collector->has_overlapped( ));
+      }
+    }
+
+    guard.reset( );
+    for (auto& thread : threads) {
+      thread.join( );
+    }
+  }
+
+  GIVEN("a partition on a JSON pointer")
+  {
+    const auto partition = make_json_partition("/user/id");
+    auto get_hash = [&](std::string payload) {
+      return partition(ServicePacket{ ServicePacket::EStatus::DATA_TRANSMISSION, std::move(payload) });
+    };
+
+    THEN("packets are hashed on the value it refers to")
+    {
+      CHECK(get_hash(R"({ "user": { "id": 1 }, "n": 1 })") == get_hash(R"({ "user": { "id": 1 }, "n": 2 })"));
+      CHECK(get_hash(R"({ "user": { "id": 1 } })") != get_hash(R"({ "user": { "id": 2 } })"));
+    }
+
+    THEN("packets without the value or without a json object payload go to the first lane")
+    {
+      CHECK(get_hash(R"({ "user": { } })") == 0);
+      CHECK(get_hash(R"({ "user": { "id": null } })") == 0);
+      CHECK(get_hash(R"("a string")") == 0);
+      CHECK(get_hash("not json") == 0);
+    }
+  }
+
+  GIVEN("an empty JSON pointer")
+  {
+    THEN("nothing is partitioned") { CHECK_FALSE(make_json_partition("")); }
+  }
+}
@@ -1,16 +1,290 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <atomic>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
 #include <doctest.h>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <trawler/services/http-server/http-server.hpp>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+namespace http = boost::beast::http;
+using tcp = boost::asio::ip::tcp;
+
+unsigned short
+get_free_port( )
+{
+  boost::asio::io_context io;
+  tcp::acceptor acceptor{ io, { boost::asio::ip::make_address("127.0.0.1"), 0 } };
+  return acceptor.local_endpoint( ).port( );
+}
+
+/*******************************************************************************
+ * A blocking http client keeping a single connection to the server open,
+ * retrying the connect until the server listens.
+ ******************************************************************************/
+class TestClient
+{
+  boost::asio::io_context context;
+  tcp::socket socket{ context };
+  boost::beast::flat_buffer buffer;
+
+public:
+  explicit TestClient(unsigned short port)
+  {
+    const auto endpoint = tcp::endpoint{ boost::asio::ip::make_address("127.0.0.1"), port };
+    const auto stop_time = std::chrono::steady_clock::now( ) + 10s;
+    boost::system::error_code ec;
+    do {
+      socket.close(ec);
+      socket.connect(endpoint, ec);
+      if (ec) {
+        std::this_thread::sleep_for(10ms);
+      }
+    } while (ec && std::chrono::steady_clock::now( ) < stop_time);
+    REQUIRE(!ec);
+  }
+
+  http::response<http::string_body> request(const std::string& target, const std::string& timeout = "")
+  {
+    http::request<http::string_body> request{ http::verb::get, target, 11 };
+    request.keep_alive(true);
+    if (!timeout.empty( )) {
+      request.set("X-Request-Timeout", timeout);
+    }
+    http::write(socket, request);
+
+    http::response<http::string_body> response;
+    http::read(socket, buffer, response);
+    return response;
+  }
+};
+
+/*******************************************************************************
+ * Serves an http server on a free port for as long as it lives, handing every
+ * request to a handler.
+ ******************************************************************************/
+class TestServer
+{
+public:
+  using handler_t = std::function<void(const trawler::ServicePacket&)>;
+
+private:
+  std::shared_ptr<trawler::ServiceContext> context;
+  rxcpp::composite_subscription subscription;
+
+public:
+  const unsigned short port = get_free_port( );
+
+  TestServer(const trawler::http_server_options_t& options,
+             handler_t handler,
+             std::shared_ptr<trawler::ServiceContext> service_context = trawler::make_service_context( ))
+    : context{ std::move(service_context) }
+  {
+    using status_t = trawler::ServicePacket::EStatus;
+    subscription = trawler::create_http_server(context, "127.0.0.1", port, options)
+                     .filter([](const auto& packet) { return packet.get_status( ) == status_t::DATA_TRANSMISSION; })
+                     .subscribe(std::move(handler));
+  }
+
+  ~TestServer( ) { subscription.unsubscribe( ); }
+
+  TestServer(const TestServer&) = delete;
+  TestServer(TestServer&&) = delete;
+  TestServer& operator=(const TestServer&) = delete;
+  TestServer& operator=(TestServer&&) = delete;
+};
+
+std::string
+get_target(const trawler::ServicePacket& packet)
+{
+  return packet.get_payload_as<nlohmann::json>( )["target"];
+}
+}
 
 SCENARIO("dummy http-server")
 {
   using namespace trawler;
   Logger::set_log_level(Logger::ELogLevel::DEBUG);
   auto context = make_service_context( );
-  create_http_server(context, "0.0.0.0", 5001, { "my-http-server" })
+  create_http_server(context, "0.0.0.0", 5001, { }, { "my-http-server" })
     .filter([](const auto& s) { return s.get_status( ) == ServicePacket::EStatus::DATA_TRANSMISSION; })
     .subscribe([](auto s) {
       std::cout << "PAYLOAD: " << s.template get_payload_as<std::string>( ) << "\n";
       s.reply("hello world");
     });
 }
+
+SCENARIO("http-server deadlines")
+{
+  GIVEN("an http server with a deadline whose pipeline drops /slow and /medium requests once they are past it")
+  {
+    auto options = trawler::http_server_options_t{ };
+    options.timeout = 100ms;
+
+    std::mutex mutex;
+    std::vector<std::thread> stages;
+    TestServer server{ options, [&](const trawler::ServicePacket& packet) {
+                        const auto target = get_target(packet);
+                        if (target != "/slow" && target != "/medium") {
+                          packet.reply(target);
+                          return;
+                        }
+                        // Like a stage dropping the request for its deadline, racing a reply made anyway
+                        std::lock_guard<std::mutex> lock{ mutex };
+                        stages.emplace_back([packet, delay = target == "/slow" ? 200ms : 50ms] {
+                          std::this_thread::sleep_for(delay);
+                          if (packet.is_expired( )) {
+                            packet.expire( );
+                          }
+                          packet.reply("late");
+                        });
+                      } };
+    TestClient client{ server.port };
+
+    WHEN("a request is past its deadline before it is answered")
+    {
+      const auto response = client.request("/slow");
+
+      THEN("it is answered 504 and the late reply is dropped")
+      {
+        CHECK(response.result( ) == http::status::gateway_timeout);
+        const auto next = client.request("/next");
+        CHECK(next.result( ) == http::status::ok);
+        CHECK(next.body( ) == "/next");
+      }
+    }
+
+    WHEN("the client asks for a deadline that is not a positive number")
+    {
+      THEN("the deadline of the server stays")
+      {
+        CHECK(client.request("/slow", "-1").result( ) == http::status::gateway_timeout);
+        CHECK(client.request("/slow", "0").result( ) == http::status::gateway_timeout);
+        CHECK(client.request("/slow", "99999999999999999999999").result( ) == http::status::gateway_timeout);
+      }
+    }
+
+    WHEN("a request is answered within the deadline of the server")
+    {
+      THEN("it is answered unless the client asked for a shorter deadline")
+      {
+        CHECK(client.request("/medium").body( ) == "late");
+        CHECK(client.request("/medium", "10").result( ) == http::status::gateway_timeout);
+      }
+    }
+
+    std::this_thread::sleep_for(300ms);
+    std::lock_guard<std::mutex> lock{ mutex };
+    for (auto& stage : stages) {
+      stage.join( );
+    }
+  }
+}
+
+SCENARIO("http-server running to completion")
+{
+  GIVEN("an http server running its pipelines to completion, answering /async from another thread")
+  {
+    auto options = trawler::http_server_options_t{ };
+    options.run_to_completion = true;
+
+    std::mutex mutex;
+    std::vector<std::thread> stages;
+    TestServer server{ options, [&](const trawler::ServicePacket& packet) {
+                        const auto target = get_target(packet);
+                        if (target != "/async") {
+                          packet.reply(target);
+                          return;
+                        }
+                        std::lock_guard<std::mutex> lock{ mutex };
+                        stages.emplace_back([packet, target] {
+                          std::this_thread::sleep_for(20ms);
+                          packet.reply(target);
+                        });
+                      } };
+    TestClient client{ server.port };
+
+    WHEN("requests are answered by the pipeline reading them")
+    {
+      THEN("each reply is written on the connection in turn")
+      {
+        for (const auto* target : { "/first", "/second", "/third" }) {
+          const auto response = client.request(target);
+          CHECK(response.result( ) == http::status::ok);
+          CHECK(response.body( ) == target);
+        }
+      }
+    }
+
+    WHEN("a request is answered from another thread")
+    {
+      const auto response = client.request("/async");
+
+      THEN("the reply is written on the connection, which keeps serving requests")
+      {
+        CHECK(response.result( ) == http::status::ok);
+        CHECK(response.body( ) == "/async");
+        CHECK(client.request("/next").body( ) == "/next");
+        CHECK(client.request("/async").body( ) == "/async");
+      }
+    }
+
+    std::lock_guard<std::mutex> lock{ mutex };
+    for (auto& stage : stages) {
+      stage.join( );
+    }
+  }
+}
+
+SCENARIO("http-server on several session threads")
+{
+  GIVEN("an http server reading requests on four session threads")
+  {
+    std::atomic<bool> is_handling{ false };
+    std::atomic<bool> overlapped{ false };
+    std::atomic<int> nof_handled{ 0 };
+    TestServer server{ { },
+                       [&](const trawler::ServicePacket& packet) {
+                         if (is_handling.exchange(true)) {
+                           overlapped = true;
+                         }
+                         std::this_thread::sleep_for(1ms);
+                         ++nof_handled;
+                         is_handling = false;
+                         packet.reply(get_target(packet));
+                       },
+                       trawler::make_service_context(4, 1) };
+
+    WHEN("several clients send requests at once")
+    {
+      constexpr auto nof_clients = 4;
+      constexpr auto nof_requests = 20;
+      std::vector<std::thread> clients;
+      for (auto i = 0; i < nof_clients; ++i) {
+        clients.emplace_back([&server] {
+          TestClient client{ server.port };
+          for (auto j = 0; j < nof_requests; ++j) {
+            client.request("/request");
+          }
+        });
+      }
+      for (auto& client : clients) {
+        client.join( );
+      }
+
+      THEN("the pipelines get one request at a time")
+      {
+        CHECK(nof_handled == nof_clients * nof_requests);
+        CHECK_FALSE(overlapped);
+      }
+    }
+  }
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <trawler/services/tcp-common/make-tcp-acceptor.hpp>
+#include <trawler/services/tcp-common/make-tcp-listener.hpp>
+#include <vector>
+
+using namespace trawler;
+
+namespace {
+
+using tcp = boost::asio::ip::tcp;
+
+const auto duration = std::chrono::seconds{ 2 };
+
+/*******************************************************************************
+ * Accepts connections with nof_acceptors acceptors on a context with a session
+ * shard per thread while clients connect and disconnect as fast as they can,
+ * and returns the number of connections accepted per second.
+ ******************************************************************************/
+double
+measure_accept_rate(std::size_t nof_threads, std::size_t nof_acceptors, std::size_t nof_clients)
+{
+  const auto logger = Logger{ "benchmark" };
+  auto context = make_service_context(nof_threads, 1, ESessionThreading::SHARDED);
+  auto listener = make_tcp_listener(context, logger, "127.0.0.1", 0, nof_acceptors);
+  auto tcp_acceptor = make_tcp_acceptor(context, logger, nof_acceptors);
+
+  std::atomic<std::size_t> accepted{ 0 };
+  auto endpoint = tcp::endpoint{ };
+  listener( ).subscribe([&](const std::shared_ptr<tcp::acceptor>& acceptor) {
+    endpoint = acceptor->local_endpoint( );
+    tcp_acceptor(acceptor).subscribe([&](const std::shared_ptr<tcp::socket>&) { ++accepted; });
+  });
+
+  std::atomic<bool> stop{ false };
+  std::vector<std::thread> clients;
+  for (auto n = std::size_t{ 0 }; n < nof_clients; ++n) {
+    clients.emplace_back([&] {
+      boost::asio::io_context client_context;
+      while (!stop) {
+        tcp::socket socket{ client_context };
+        boost::system::error_code ec;
+        socket.connect(endpoint, ec);
+        // Reset rather than close, so the client ports aren't exhausted by connections in TIME_WAIT
+        socket.set_option(boost::asio::socket_base::linger(true, 0), ec);
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(duration);
+  const auto nof_accepted = accepted.load( );
+  stop = true;
+  for (auto& client : clients) {
+    client.join( );
+  }
+
+  return static_cast<double>(nof_accepted) / std::chrono::duration<double>(duration).count( );
+}
+}
+
+// Takes the number of session threads, by default half the hardware threads (the clients get the other half). The
+// number of acceptors is doubled from one up to one per session thread
+int
+main(int argc, char** argv)
+{
+  Logger::set_log_level(Logger::ELogLevel::CRITICAL);
+
+  const auto nof_threads = argc > 1 ? std::max<std::size_t>(std::stoul(argv[1]), 1)
+                                    : std::max<std::size_t>(std::thread::hardware_concurrency( ) / 2, 2);
+  const auto nof_clients = nof_threads;
+
+  for (auto nof_acceptors = std::size_t{ 1 };; nof_acceptors = std::min(nof_acceptors * 2, nof_threads)) {
+    const auto rate = measure_accept_rate(nof_threads, nof_acceptors, nof_clients);
+    std::cout << nof_acceptors << " acceptor(s) on " << nof_threads << " session threads: " << rate
+              << " connections/s\n";
+    if (nof_acceptors == nof_threads) {
+      break;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,197 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl.hpp>
+#include <doctest.h>
+#include <memory>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <thread>
+#include <trawler/services/tcp-common/client-tls-context.hpp>
+#include <trawler/services/tcp-common/make-tcp-acceptor.hpp>
+#include <trawler/services/tcp-common/make-tcp-listener.hpp>
+#include <vector>
+
+using namespace trawler;
+
+namespace {
+
+using tcp = boost::asio::ip::tcp;
+
+/*******************************************************************************
+ * Gives a server context a freshly generated self-signed certificate.
+ ******************************************************************************/
+void
+use_self_signed_certificate(boost::asio::ssl::context& context)
+{
+  auto key = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>{ EVP_PKEY_new( ), &EVP_PKEY_free };
+  auto* rsa = RSA_new( );
+  auto exponent = std::unique_ptr<BIGNUM, decltype(&BN_free)>{ BN_new( ), &BN_free };
+  BN_set_word(exponent.get( ), RSA_F4);
+  RSA_generate_key_ex(rsa, 2048, exponent.get( ), nullptr);
+  EVP_PKEY_assign_RSA(key.get( ), rsa);
+
+  auto certificate = std::unique_ptr<X509, decltype(&X509_free)>{ X509_new( ), &X509_free };
+  ASN1_INTEGER_set(X509_get_serialNumber(certificate.get( )), 1);
+  X509_gmtime_adj(X509_get_notBefore(certificate.get( )), 0);
+  X509_gmtime_adj(X509_get_notAfter(certificate.get( )), 3600);
+  X509_set_pubkey(certificate.get( ), key.get( ));
+  auto* name = X509_get_subject_name(certificate.get( ));
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(certificate.get( ), name);
+  X509_sign(certificate.get( ), key.get( ), EVP_sha256( ));
+
+  SSL_CTX_use_certificate(context.native_handle( ), certificate.get( ));
+  SSL_CTX_use_PrivateKey(context.native_handle( ), key.get( ));
+}
+
+/*******************************************************************************
+ * Connects to a local tls server using the shared client context and returns
+ * whether the session was resumed.
+ ******************************************************************************/
+bool
+connect(ClientTlsContext& tls, unsigned short port)
+{
+  boost::asio::io_context context;
+  boost::asio::ssl::stream<tcp::socket> stream{ context, tls.get( ) };
+  REQUIRE(tls.prepare(stream.native_handle( ), "localhost"));
+  stream.next_layer( ).connect({ boost::asio::ip::make_address("127.0.0.1"), port });
+  stream.handshake(boost::asio::ssl::stream_base::client);
+
+  // TLS 1.3 hands out session tickets after the handshake, read until the server closes
+  char data[1];
+  boost::system::error_code ec;
+  stream.read_some(boost::asio::buffer(data), ec);
+
+  return SSL_session_reused(stream.native_handle( )) == 1;
+}
+}
+
+SCENARIO("shared client tls context")
+{
+  GIVEN("the process-wide client tls context")
+  {
+    const auto& tls = get_client_tls_context( );
+
+    THEN("every caller gets the same one") { CHECK(tls == get_client_tls_context( )); }
+
+    WHEN("preparing a connection")
+    {
+      boost::asio::io_context context;
+      boost::asio::ssl::stream<tcp::socket> stream{ context, tls->get( ) };
+      REQUIRE(tls->prepare(stream.native_handle( ), "example.com"));
+
+      THEN("the SNI host name is set")
+      {
+        CHECK(std::string{ SSL_get_servername(stream.native_handle( ), TLSEXT_NAMETYPE_host_name) } == "example.com");
+      }
+    }
+  }
+
+  GIVEN("a local tls server")
+  {
+    constexpr auto nof_connections = 2;
+
+    boost::asio::io_context server_context;
+    boost::asio::ssl::context server_tls{ boost::asio::ssl::context::sslv23_server };
+    use_self_signed_certificate(server_tls);
+    tcp::acceptor acceptor{ server_context, { boost::asio::ip::make_address("127.0.0.1"), 0 } };
+
+    auto server = std::thread{ [&] {
+      for (auto n = 0; n < nof_connections; ++n) {
+        boost::asio::ssl::stream<tcp::socket> stream{ server_context, server_tls };
+        acceptor.accept(stream.next_layer( ));
+        boost::system::error_code ec;
+        stream.handshake(boost::asio::ssl::stream_base::server, ec);
+        stream.shutdown(ec);
+      }
+    } };
+
+    WHEN("connecting to it twice")
+    {
+      ClientTlsContext tls;
+      const auto port = acceptor.local_endpoint( ).port( );
+      const auto first = connect(tls, port);
+      const auto second = connect(tls, port);
+      server.join( );
+
+      THEN("the second connection resumes the session of the first")
+      {
+        CHECK(!first);
+        CHECK(tls.has_session("localhost"));
+        CHECK(second);
+      }
+    }
+  }
+}
+
+SCENARIO("SO_REUSEPORT listeners")
+{
+  GIVEN("a service context with sharded session threads and a listener with three acceptors")
+  {
+    using acceptor_tp = std::shared_ptr<tcp::acceptor>;
+    using socket_tp = std::shared_ptr<tcp::socket>;
+
+    const auto logger = Logger{ "tcp-listener" };
+    auto context = make_service_context(3, 1, ESessionThreading::SHARDED);
+    auto listener = make_tcp_listener(context, logger, "127.0.0.1", 0, 3);
+
+    auto acceptors = std::vector<acceptor_tp>{ };
+    listener( ).subscribe([&](const acceptor_tp& acceptor) { acceptors.push_back(acceptor); });
+
+    THEN("they share a port, each on a session shard of its own")
+    {
+      REQUIRE(acceptors.size( ) == 3);
+      for (const auto& acceptor : acceptors) {
+        CHECK(acceptor->local_endpoint( ).port( ) == acceptors.front( )->local_endpoint( ).port( ));
+      }
+      CHECK(&get_io_context(*acceptors[0]) != &get_io_context(*acceptors[1]));
+      CHECK(&get_io_context(*acceptors[1]) != &get_io_context(*acceptors[2]));
+    }
+
+    WHEN("clients connect")
+    {
+      constexpr auto nof_connections = 30;
+      std::mutex mutex;
+      std::vector<socket_tp> sockets;
+
+      auto tcp_acceptor = make_tcp_acceptor(context, logger, acceptors.size( ));
+      for (const auto& acceptor : acceptors) {
+        tcp_acceptor(acceptor).subscribe([&](const socket_tp& socket) {
+          std::lock_guard<std::mutex> lock{ mutex };
+          sockets.push_back(socket);
+        });
+      }
+
+      boost::asio::io_context client_context;
+      std::vector<tcp::socket> clients;
+      for (auto n = 0; n < nof_connections; ++n) {
+        clients.emplace_back(client_context);
+        clients.back( ).connect(acceptors.front( )->local_endpoint( ));
+      }
+
+      const auto stop_time = std::chrono::steady_clock::now( ) + std::chrono::seconds{ 10 };
+      auto nof_accepted = [&] {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return sockets.size( );
+      };
+      while (nof_accepted( ) < nof_connections && std::chrono::steady_clock::now( ) < stop_time) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+      }
+
+      THEN("every connection is accepted onto the shard of the acceptor that took it")
+      {
+        std::lock_guard<std::mutex> lock{ mutex };
+        REQUIRE(sockets.size( ) == nof_connections);
+        for (const auto& socket : sockets) {
+          const auto* shard = &get_io_context(*socket);
+          const auto on_acceptor_shard = std::any_of(cbegin(acceptors), cend(acceptors), [&](const auto& acceptor) {
+            return &get_io_context(*acceptor) == shard;
+          });
+          CHECK(on_acceptor_shard);
+        }
+      }
+
+    }
+  }
+}